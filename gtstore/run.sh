@@ -16,6 +16,18 @@ Scenarios:
     test4        Failure test with two node kills (7 nodes, RF=3)
     throughput   Performance test (200k ops, RF 1/3/5)
     load         Load-balance histogram test (100k inserts)
+    hashbench    Microbenchmark of std::hash vs the ring hash
+    placement    Compare ring, rendezvous and jump placement (balance, lookup, movement)
+    hotkey       Read one key repeatedly and show how reads spread once it is flagged hot
+    bounded      Skewed reads under ring vs bounded-load placement (max/mean per round)
+    restart      Restart the manager and read back right away from the reloaded membership
+    tablebench   Routing table payload size and build/parse cost at 100 to 10k entries
+    compression  lz codec ratio and speed, then a cluster round trip of compressed and plain values
+    streaming    Multi-MB values via put_stream/get_stream vs hand-sharded 900-byte puts (MB/s)
+    tokenize     Heartbeat/gossip parsing: istringstream split vs string_view split_view (ns, allocations)
+    schema       Heartbeat as delimited text vs the typed message schema (bytes, ns, allocations)
+    checksum     CRC32C speed (SSE4.2 vs table), corrupt-frame rejection, mixed checksum on/off round trip
+    decommission Remove a node under traffic by draining it, then by killing it (failed client ops)
 
 Options:
     -h, --help   Show this message and exit
@@ -57,8 +69,20 @@ STOP_SCRIPT="$ROOT_DIR/stop_service"
 PID_FILE="$SCRIPT_DIR/service_pids.txt"
 TP_OPS=${GTSTORE_TP_OPS:-200000}
 LB_INSERTS=${GTSTORE_LB_INSERTS:-100000}
+DRAIN_WAIT=${GTSTORE_DRAIN_WAIT:-45}
 THROUGHPUT_FILE="$SCRIPT_DIR/logs/perf_throughput.csv"
 LOAD_FILE="$SCRIPT_DIR/logs/perf_loadbalance.csv"
+HASH_FILE="$SCRIPT_DIR/logs/perf_hash.csv"
+PLACEMENT_FILE="$SCRIPT_DIR/logs/perf_placement.csv"
+HOTKEY_FILE="$SCRIPT_DIR/logs/perf_hotkey.csv"
+BOUNDED_FILE="$SCRIPT_DIR/logs/perf_bounded.csv"
+DECOMMISSION_FILE="$SCRIPT_DIR/logs/perf_decommission.csv"
+TABLE_FILE="$SCRIPT_DIR/logs/perf_table.csv"
+COMPRESS_FILE="$SCRIPT_DIR/logs/perf_compress.csv"
+CHECKSUM_FILE="$SCRIPT_DIR/logs/perf_checksum.csv"
+STREAM_FILE="$SCRIPT_DIR/logs/perf_stream.csv"
+TOKENIZE_FILE="$SCRIPT_DIR/logs/perf_tokenize.csv"
+SCHEMA_FILE="$SCRIPT_DIR/logs/perf_schema.csv"
 
 mkdir -p "$SCRIPT_DIR/logs"
 rm -f "$SCRIPT_DIR"/logs/* >/dev/null 2>&1 || true
@@ -73,12 +97,27 @@ cleanup() {
 
 trap cleanup EXIT
 
+
+restart_manager() {
+        local pid
+        pid=$(sed -n "1p" "$PID_FILE")
+        kill -9 "$pid" 2>/dev/null || true
+        sleep 1
+        GTSTORE_REPL="$1" ./bin/manager >> "$SCRIPT_DIR/logs/manager.log" 2>&1 &
+        sed -i "1s/.*/$!/" "$PID_FILE"
+        echo "Restarted manager (pid $!)"
+}
+
+# kill_storage <index> [drain]: a plain call SIGKILLs the node to model a crash. With "drain" the node is
+# decommissioned first and left to hand its keys off and exit by itself; it is only killed if it is still
+# running after GTSTORE_DRAIN_WAIT seconds.
 kill_storage() {
         if [[ ! -f "$PID_FILE" ]]; then
                 echo "No pid file found for killing storage"
                 return 1
         fi
         local index="$1"
+        local mode="${2:-kill}"
         local line=$((index + 2))
         local pid
         pid=$(sed -n "${line}p" "$PID_FILE")
@@ -86,6 +125,18 @@ kill_storage() {
                 echo "Storage index $index not found in pid file"
                 return 1
         fi
+        if [[ "$mode" == "drain" ]]; then
+                ./bin/test_app decommission 0 "node$((index + 1))"
+                local waited
+                for ((waited = 0; waited < DRAIN_WAIT; ++waited)); do
+                        if ! kill -0 "$pid" 2>/dev/null; then
+                                echo "Storage index $index drained and exited (pid $pid)"
+                                return 0
+                        fi
+                        sleep 1
+                done
+                echo "Storage index $index still running after ${DRAIN_WAIT}s of draining"
+        fi
         if kill -0 "$pid" 2>/dev/null; then
                 kill -9 "$pid" 2>/dev/null || true
                 echo "Killed storage index $index (pid $pid)"
@@ -155,6 +206,127 @@ case "$SCENARIO" in
         echo "Load-balance suite completed. CSV: $LOAD_FILE"
         exit 0
         ;;
+    hashbench)
+        make >/dev/null
+        echo "hash,hashes,seconds,ns_per_hash,sink" > "$HASH_FILE"
+        GTSTORE_PERF_FILE="$HASH_FILE" ./bin/test_app hash_bench 700 2000
+        echo "Hash benchmark completed. CSV: $HASH_FILE"
+        exit 0
+        ;;
+    placement)
+        make >/dev/null
+        echo "placement,nodes,keys,max_over_mean,ns_per_lookup,moved_on_join,moved_on_leave,sink" > "$PLACEMENT_FILE"
+        for nodes in 7 50 1000; do
+                GTSTORE_PERF_FILE="$PLACEMENT_FILE" ./bin/test_app placement_compare 800 "$nodes" 100000
+        done
+        echo "Placement comparison completed. CSV: $PLACEMENT_FILE"
+        exit 0
+        ;;
+    hotkey)
+        export GTSTORE_HOT_THRESHOLD=${GTSTORE_HOT_THRESHOLD:-50}
+        start_cluster 3 3
+        sleep 3
+        ./bin/test_app hot_reads 900 1000 >/dev/null
+        echo "node_log,hot_key_gets" > "$HOTKEY_FILE"
+        for log in "$SCRIPT_DIR"/logs/storage_node*.log; do
+                echo "$(basename "$log" .log),$(grep -c "GET hit key=hot_key " "$log" || true)" >> "$HOTKEY_FILE"
+        done
+        cat "$HOTKEY_FILE"
+        echo "Hot-key suite completed. CSV: $HOTKEY_FILE"
+        exit 0
+        ;;
+    bounded)
+        echo "placement,round,reads,max_over_mean" > "$BOUNDED_FILE"
+        for mode in ring bounded; do
+                "$START_SCRIPT" --nodes 5 --rep 2 --placement "$mode"
+                sleep 3
+                GTSTORE_PERF_FILE="$BOUNDED_FILE" ./bin/test_app skewed_reads 1000 8 "$mode" >/dev/null
+                cleanup
+                sleep 2
+        done
+        cat "$BOUNDED_FILE"
+        echo "Bounded-load suite completed. CSV: $BOUNDED_FILE"
+        exit 0
+        ;;
+    tablebench)
+        make >/dev/null
+        echo "entries,payload_bytes,build_us,parse_us,sink" > "$TABLE_FILE"
+        for entries in 100 1000 10000; do
+                GTSTORE_PERF_FILE="$TABLE_FILE" ./bin/test_app table_codec_bench 1300 "$entries" 50
+        done
+        echo "Table codec benchmark completed. CSV: $TABLE_FILE"
+        exit 0
+        ;;
+    compression)
+        echo "input,bytes,compressed_bytes,ratio,compress_mb_s,decompress_mb_s,roundtrip,sink" > "$COMPRESS_FILE"
+        GTSTORE_PERF_FILE="$COMPRESS_FILE" ./bin/test_app compress_bench 1400 20000
+        start_cluster 2 2
+        sleep 3
+        ./bin/test_app value_roundtrip 1401 | grep -a "Round trip"
+        grep -ah "PUT key=roundtrip_4 " "$SCRIPT_DIR"/logs/storage_node1.log | head -1
+        echo "Compression suite completed. CSV: $COMPRESS_FILE"
+        exit 0
+        ;;
+    streaming)
+        echo "method,bytes,put_mb_s,get_mb_s,roundtrip" > "$STREAM_FILE"
+        start_cluster 3 2
+        sleep 3
+        GTSTORE_PERF_FILE="$STREAM_FILE" ./bin/test_app stream_roundtrip 1601 1 shards | grep -a -E "^Streamed|^(stream|sharded),"
+        for megabytes in 4 16; do
+            GTSTORE_PERF_FILE="$STREAM_FILE" ./bin/test_app stream_roundtrip 1602 "$megabytes" | grep -a -E "^Streamed|^stream,"
+        done
+        grep -ah "Stream PUT key=blob_16mb" "$SCRIPT_DIR"/logs/storage_node*.log | head -1
+        echo "Streaming suite completed. CSV: $STREAM_FILE"
+        exit 0
+        ;;
+    tokenize)
+        echo "payload,bytes,split_ns,split_view_ns,split_allocs,split_view_allocs,agree" > "$TOKENIZE_FILE"
+        GTSTORE_PERF_FILE="$TOKENIZE_FILE" ./bin/alloc_bench tokenize_bench 200000
+        echo "Tokenizer benchmark completed. CSV: $TOKENIZE_FILE"
+        exit 0
+        ;;
+    schema)
+        echo "message,text_bytes,typed_bytes,text_ns,typed_ns,text_allocs,typed_allocs,agree" > "$SCHEMA_FILE"
+        GTSTORE_PERF_FILE="$SCHEMA_FILE" ./bin/alloc_bench schema_bench 200000
+        echo "Schema benchmark completed. CSV: $SCHEMA_FILE"
+        exit 0
+        ;;
+    checksum)
+        echo "bytes,hardware_mb_s,software_mb_s,agree" > "$CHECKSUM_FILE"
+        GTSTORE_PERF_FILE="$CHECKSUM_FILE" ./bin/test_app checksum_bench 1500 20000
+        start_cluster 2 2
+        sleep 3
+        # the cluster sends checksummed frames; this client does not, and both sides still agree
+        GTSTORE_CHECKSUM=0 ./bin/test_app value_roundtrip 1501 | grep -a "Round trip"
+        echo "Checksum suite completed. CSV: $CHECKSUM_FILE"
+        exit 0
+        ;;
+    restart)
+        start_cluster 3 2
+        sleep 3
+        ./bin/test_app failure_load 1101
+        restart_manager 2
+        sleep 0.5
+        ./bin/test_app failure_verify 1102
+        grep -m1 "Restored" "$SCRIPT_DIR/logs/manager.log" || true
+        ;;
+    decommission)
+        echo "removal,ops,errors" > "$DECOMMISSION_FILE"
+        for mode in drain kill; do
+                start_cluster 4 2
+                sleep 3
+                GTSTORE_PERF_FILE="$DECOMMISSION_FILE" ./bin/test_app maintenance_traffic 1200 20 "$mode" >/dev/null &
+                traffic=$!
+                sleep 5
+                kill_storage 0 "$mode"
+                wait "$traffic"
+                cleanup
+                sleep 2
+        done
+        cat "$DECOMMISSION_FILE"
+        echo "Decommission suite completed. CSV: $DECOMMISSION_FILE"
+        exit 0
+        ;;
     *)
         echo "Unknown scenario: $SCENARIO"
         usage
@@ -0,0 +1,231 @@
+#include "messages.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// NEWLY ADDED: parsing benchmarks that report heap allocations per operation.
+// They live in their own binary because counting replaces the global operator new;
+// test_app and the servers keep the default allocator.
+std::atomic<size_t> heap_allocations{0};
+
+void *operator new(size_t size) {
+	++heap_allocations;
+	void *block = std::malloc(size ? size : 1);
+	if (!block) {
+		throw std::bad_alloc();
+	}
+	return block;
+}
+
+void operator delete(void *block) noexcept {
+	std::free(block);
+}
+
+namespace {
+// This appends a performance line when requested.
+void append_perf_line(const std::string &line) {
+	cout << line << "\n";
+	const char *path = std::getenv("GTSTORE_PERF_FILE");
+	if (path && *path) {
+		std::ofstream out(path, std::ios::app);
+		if (out.is_open()) {
+			out << line << "\n";
+		}
+	}
+}
+
+// This prints a simple usage hint.
+void print_usage(const char *prog) {
+	cout << "Usage: " << prog << " <test> [rounds]\n";
+	cout << "Tests: tokenize_bench, schema_bench\n";
+}
+}
+
+// This is the tokenizer gtstore_utils used before split_view: a stream plus one new string per field.
+vector<string> legacy_split(const string &input, char delimiter) {
+	vector<string> parts;
+	string current;
+	std::istringstream stream(input);
+	while (std::getline(stream, current, delimiter)) {
+		parts.push_back(current);
+	}
+	return parts;
+}
+
+// This compares the old istringstream split and stoull against split_view and parse_u64 on a heartbeat
+// with hot keys and a gossip datagram with piggybacked rows, in time and heap allocations per parse.
+void tokenize_bench_driver(int rounds) {
+	cout << "Running tokenizer benchmark with " << rounds << " rounds.\n";
+	string heartbeat = "node3|48211|";
+	for (int i = 0; i < 16; ++i) {
+		heartbeat += (i ? "," : "") + to_string(0x9E3779B97F4A7C15ULL * (i + 1));
+	}
+	heartbeat += "|node5,node6";
+	string datagram = "ping|node1|88412|node4|";
+	for (int i = 0; i < 6; ++i) {
+		datagram += (i ? ";" : "") + string("node") + to_string(i) + ",127.0.0.1," + to_string(6100 + i) + ",0," + to_string(1000 + i);
+	}
+	vector<pair<string, string>> inputs = {{"heartbeat", heartbeat}, {"gossip", datagram}};
+	for (const auto &input : inputs) {
+		char outer = '|';
+		bool is_heartbeat = input.first == "heartbeat";
+		char inner = is_heartbeat ? ',' : ';';
+		size_t number_field = is_heartbeat ? 1 : 2;
+		size_t list_field = is_heartbeat ? 2 : 4;
+		uint64_t legacy_sum = 0;
+		size_t before = heap_allocations;
+		auto start = std::chrono::steady_clock::now();
+		for (int r = 0; r < rounds; ++r) {
+			vector<string> fields = legacy_split(input.second, outer);
+			legacy_sum += std::stoull(fields[number_field]);
+			for (const auto &item : legacy_split(fields[list_field], inner)) {
+				for (const auto &part : legacy_split(item, ',')) {
+					legacy_sum += part.size();
+				}
+			}
+		}
+		auto middle = std::chrono::steady_clock::now();
+		size_t legacy_allocations = heap_allocations - before;
+		uint64_t view_sum = 0;
+		vector<std::string_view> fields;
+		vector<std::string_view> items;
+		vector<std::string_view> parts;
+		before = heap_allocations;
+		auto view_start = std::chrono::steady_clock::now();
+		for (int r = 0; r < rounds; ++r) {
+			gtstore_utils::split_view(input.second, outer, fields);
+			uint64_t number = 0;
+			gtstore_utils::parse_u64(fields[number_field], number);
+			view_sum += number;
+			gtstore_utils::split_view(fields[list_field], inner, items);
+			for (std::string_view item : items) {
+				gtstore_utils::split_view(item, ',', parts);
+				for (std::string_view part : parts) {
+					view_sum += part.size();
+				}
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+		size_t view_allocations = heap_allocations - before;
+		double legacy_ns = std::chrono::duration<double, std::nano>(middle - start).count() / rounds;
+		double view_ns = std::chrono::duration<double, std::nano>(end - view_start).count() / rounds;
+		std::ostringstream line;
+		line << input.first << "," << input.second.size() << "," << legacy_ns << "," << view_ns << ","
+		     << static_cast<double>(legacy_allocations) / rounds << "," << static_cast<double>(view_allocations) / rounds << ","
+		     << (legacy_sum == view_sum ? "ok" : "MISMATCH");
+		append_perf_line(line.str());
+	}
+}
+
+// This compares a heartbeat sent as "id|load|hot,keys|dead,ids" text (concatenated, then split_view and parse_u64)
+// with the typed HEARTBEAT schema (encoded into a reused buffer, decoded into views), per round trip.
+void schema_bench_driver(int rounds) {
+	cout << "Running message schema benchmark with " << rounds << " rounds.\n";
+	vector<uint64_t> hot;
+	for (int i = 0; i < 16; ++i) {
+		hot.push_back(0x9E3779B97F4A7C15ULL * (i + 1));
+	}
+	vector<string> dead = {"node5", "node6"};
+	string node_id = "node3";
+	uint64_t requests = 48211;
+
+	uint64_t text_sum = 0;
+	size_t text_bytes = 0;
+	vector<std::string_view> fields;
+	vector<std::string_view> items;
+	string buffer;
+	size_t before = heap_allocations;
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; ++r) {
+		buffer.clear();
+		buffer += node_id;
+		buffer.push_back('|');
+		buffer += to_string(requests + r);
+		buffer.push_back('|');
+		for (size_t i = 0; i < hot.size(); ++i) {
+			if (i > 0) {
+				buffer.push_back(',');
+			}
+			buffer += to_string(hot[i]);
+		}
+		buffer.push_back('|');
+		gtstore_utils::append_joined(buffer, dead, ',');
+		text_bytes = buffer.size();
+		gtstore_utils::split_view(buffer, '|', fields);
+		uint64_t number = 0;
+		gtstore_utils::parse_u64(fields[1], number);
+		text_sum += number + fields[0].size();
+		gtstore_utils::split_view(fields[2], ',', items);
+		for (std::string_view item : items) {
+			gtstore_utils::parse_u64(item, number);
+			text_sum += number;
+		}
+		gtstore_utils::split_view(fields[3], ',', items);
+		text_sum += items.size();
+	}
+	auto middle = std::chrono::steady_clock::now();
+	size_t text_allocations = heap_allocations - before;
+
+	uint64_t typed_sum = 0;
+	size_t typed_bytes = 0;
+	Heartbeat beat{requests, node_id, hot, {dead.begin(), dead.end()}};
+	Heartbeat decoded;
+	before = heap_allocations;
+	auto typed_start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; ++r) {
+		beat.requests = requests + r;
+		buffer.clear();
+		encode_message<MessageType::HEARTBEAT>(beat, buffer);
+		typed_bytes = buffer.size();
+		if (decode_message<MessageType::HEARTBEAT>(buffer, decoded)) {
+			typed_sum += decoded.requests + decoded.node_id.size() + decoded.dead.size();
+			for (uint64_t key_hash : decoded.hot_keys) {
+				typed_sum += key_hash;
+			}
+		}
+	}
+	auto end = std::chrono::steady_clock::now();
+	size_t typed_allocations = heap_allocations - before;
+	std::ostringstream line;
+	line << "heartbeat," << text_bytes << "," << typed_bytes << ","
+	     << std::chrono::duration<double, std::nano>(middle - start).count() / rounds << ","
+	     << std::chrono::duration<double, std::nano>(end - typed_start).count() / rounds << ","
+	     << static_cast<double>(text_allocations) / rounds << "," << static_cast<double>(typed_allocations) / rounds << ","
+	     << (text_sum == typed_sum ? "ok" : "MISMATCH");
+	append_perf_line(line.str());
+
+	// an action byte past HeartbeatAction::REGISTER must not decode
+	HeartbeatAck ack;
+	string bad_action(1, static_cast<char>(static_cast<uint8_t>(HeartbeatAction::REGISTER) + 1));
+	cout << "Out-of-range enum rejected: " << (decode_message<MessageType::HEARTBEAT_ACK>(bad_action, ack) ? "no" : "yes") << "\n";
+}
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		print_usage(argv[0]);
+		return 1;
+	}
+	string test = string(argv[1]);
+	int rounds = (argc >= 3) ? atoi(argv[2]) : 200000;
+	if (test == "tokenize_bench") {
+		tokenize_bench_driver(std::max(1, rounds));
+	} else if (test == "schema_bench") {
+		schema_bench_driver(std::max(1, rounds));
+	} else {
+		print_usage(argv[0]);
+		return 1;
+	}
+	return 0;
+}
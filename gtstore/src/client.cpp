@@ -1,27 +1,43 @@
 #include "gtstore.hpp"
+#include "codec.hpp"
+#include "crc32c.hpp"
+#include "hash.hpp"
+#include "lz.hpp"
+#include "messages.hpp"
 #include "utils.hpp"
 
 #include <algorithm>
-#include <functional>
 #include <sstream>
 
 using namespace gtstore_utils;
 
 namespace {
-// This prints a routing table snapshot for logging.
-std::string describe_table(const std::vector<StorageNodeInfo> &nodes) {
-	if (nodes.empty()) {
-		return "<empty>";
-	}
-	std::ostringstream out;
-	for (size_t i = 0; i < nodes.size(); ++i) {
-		out << nodes[i].node_id << "@" << nodes[i].address.host << ":" << nodes[i].address.port
-		    << " token=" << nodes[i].token;
-		if (i + 1 < nodes.size()) {
-			out << " | ";
+// values shorter than this go out as is; compression rarely pays for itself on small values
+const size_t DEFAULT_COMPRESS_MIN_BYTES = 256;
+// a misrouted operation refreshes the table and starts over at most this many times
+const int MAX_OWNER_REFRESHES = 3;
+
+// NEWLY ADDED: how one pass of an operation over a key's replicas ended
+enum class PassOutcome : uint8_t {
+	DONE = 0,
+	FAILED = 1,
+	MISROUTED = 2
+};
+
+// This runs a pass over the key's replicas and runs it again on the newer table each time it ends on a
+// WRONG_OWNER that moved the table forward, up to MAX_OWNER_REFRESHES times. True when a pass succeeded.
+template <typename Pass>
+bool run_with_owner_refresh(const std::string &operation, Pass pass) {
+	for (int refreshes = 0;; ++refreshes) {
+		PassOutcome outcome = pass();
+		if (outcome != PassOutcome::MISROUTED) {
+			return outcome == PassOutcome::DONE;
+		}
+		if (refreshes == MAX_OWNER_REFRESHES) {
+			log_line("WARN", operation + " still misrouted after " + std::to_string(refreshes) + " table refreshes");
+			return false;
 		}
 	}
-	return out.str();
 }
 }
 
@@ -32,82 +48,118 @@ GTStoreClient::GTStoreClient() {
 	replication_factor = 1;
 }
 
+// This hashes a key once per operation.
+uint64_t GTStoreClient::hash_key(const string &key) {
+	return ring_hash(key);
+}
+
 // This picks a storage node based on key hash.
-StorageNodeInfo GTStoreClient::pick_primary(const string &key) {
-	return pick_node_for_attempt(key, 0);
+StorageNodeInfo GTStoreClient::pick_primary(uint64_t key_hash) {
+	return pick_node_for_attempt(key_hash, 0);
 }
 
-// This picks the Nth replica for the hash.
-StorageNodeInfo GTStoreClient::pick_node_for_attempt(const string &key, size_t attempt) {
-	if (routing_table.empty()) {
-		return StorageNodeInfo{"", {DEFAULT_MANAGER_HOST, DEFAULT_STORAGE_BASE_PORT}, 0};
+// This picks the Nth replica from the precomputed preference list; past the replicas come draining nodes, for reads.
+StorageNodeInfo GTStoreClient::pick_node_for_attempt(uint64_t key_hash, size_t attempt) {
+	const StorageNodeInfo *node = routing_index.read_replica(key_hash, attempt);
+	if (!node) {
+		return StorageNodeInfo{"", {DEFAULT_MANAGER_HOST, DEFAULT_STORAGE_BASE_PORT}, 0, 1, 0};
 	}
-	std::hash<std::string> hasher;
-	uint64_t hash_value = hasher(key);
-	size_t start_index = routing_table.size();
-	for (size_t i = 0; i < routing_table.size(); ++i) {
-		if (hash_value <= routing_table[i].token) {
-			start_index = i;
-			break;
-		}
-	}
-	if (start_index == routing_table.size()) {
-		start_index = 0;
-	}
-	size_t index = (start_index + attempt) % routing_table.size();
-	return routing_table[index];
+	return *node;
 }
 
-// This turns payload into value list.
-val_t GTStoreClient::parse_value(const string &payload) {
+// This turns an encoded, possibly compressed payload into the value list; malformed payloads give an empty list.
+val_t GTStoreClient::parse_value(const string &payload, uint16_t flags) {
 	val_t parts;
-	auto strings = split(payload, ',');
-	for (auto &entry : strings) {
-		if (!entry.empty()) {
-			parts.push_back(entry);
-		}
+	std::string expanded;
+	if ((flags & MESSAGE_FLAG_COMPRESSED) && !lz_decompress(payload, expanded, MAX_VALUE_BYTE_PER_REQUEST)) {
+		log_line("WARN", "undecodable compressed value of " + std::to_string(payload.size()) + " bytes");
+		return parts;
+	}
+	if (!decode_value((flags & MESSAGE_FLAG_COMPRESSED) ? expanded : payload, parts)) {
+		log_line("WARN", "malformed value payload of " + std::to_string(payload.size()) + " bytes");
 	}
 	return parts;
 }
 
-// This turns value list into string.
+// This encodes the value list (varint count, then length-prefixed elements).
 string GTStoreClient::serialize_value(const val_t &value) {
-	return join(value, ',');
+	return encode_value(value);
 }
 
-// This refreshes the routing table from manager.
-bool GTStoreClient::refresh_table() {
-	int fd = connect_to_host(manager_address);
-	if (fd < 0) {
-		log_line("ERROR", "failed to reach manager for refresh");
-		return false;
+// This compresses an encoded value in place when it is large enough and actually shrinks.
+// Returns the header flags to send it with.
+uint16_t GTStoreClient::maybe_compress(string &encoded) {
+	if (compress_min_bytes == 0 || encoded.size() < compress_min_bytes) {
+		return 0;
 	}
-	if (!send_message(fd, MessageType::CLIENT_HELLO, "")) {
-		log_line("ERROR", "could not send hello");
-		close(fd);
-		return false;
+	std::string block = lz_compress(encoded);
+	if (block.size() >= encoded.size()) {
+		return 0;
 	}
-	MessageType type;
-	std::string payload;
-	if (!recv_message(fd, type, payload)) {
-		log_line("ERROR", "no table from manager");
-		close(fd);
-		return false;
+	encoded.swap(block);
+	return MESSAGE_FLAG_COMPRESSED;
+}
+
+// This refreshes the routing table, asking only for changes when it has a table. Fetches rotate over
+// the storage nodes in the current table; the manager is used to bootstrap and when a node is behind.
+bool GTStoreClient::refresh_table(uint64_t min_epoch) {
+	TableSnapshot table = routing_index.table();
+	uint64_t target_epoch = std::max(min_epoch, table.epoch);
+	if (subscription) {
+		target_epoch = std::max(target_epoch, subscription->announced_epoch());
+	}
+	SyncResult result = SyncResult::FAILED;
+	std::string source = "manager";
+	const std::vector<StorageNodeInfo> &peers = routing_index.entries();
+	if (!peers.empty()) {
+		const StorageNodeInfo &peer = peers[table_source_cursor++ % peers.size()];
+		result = sync_table(peer.address, table);
+		source = peer.node_id;
+		// a node that has not caught up yet cannot give us what the manager announced
+		if (result == SyncResult::FAILED || table.epoch < target_epoch) {
+			table = routing_index.table();
+			result = SyncResult::FAILED;
+		}
+	}
+	if (result == SyncResult::FAILED) {
+		source = "manager";
+		result = sync_table(manager_address, table);
+	}
+	if (result != SyncResult::UPDATED) {
+		return result == SyncResult::UNCHANGED && !routing_index.empty();
+	}
+	replication_factor = std::max<size_t>(1, table.replication_factor);
+	routing_index.rebuild(table);
+	log_line("INFO", "Routing table epoch " + std::to_string(table.epoch) + " from " + source + " now has " + std::to_string(routing_index.entries().size()) + " nodes with replication " + std::to_string(replication_factor) + " placement " + placement_name(table.placement));
+	log_line("INFO", "Routing table detail: " + describe_nodes(routing_index.entries()));
+	return !routing_index.empty();
+}
+
+// This refreshes before an operation when the manager has announced a different epoch.
+void GTStoreClient::catch_up_with_subscription() {
+	if (!subscription || !subscription->connected()) {
+		return;
+	}
+	uint64_t announced = subscription->announced_epoch();
+	if (announced != 0 && announced != routing_index.table().epoch) {
+		refresh_table();
+	}
+}
+
+// This refreshes after a WRONG_OWNER reply when the storage node's epoch is newer than our table.
+bool GTStoreClient::refresh_on_wrong_owner(const string &reply) {
+	EpochMessage owner{0};
+	if (!decode_message<MessageType::WRONG_OWNER>(reply, owner)) {
+		owner.epoch = 0;
 	}
-	close(fd);
-	if (type != MessageType::TABLE_PUSH) {
-		log_line("WARN", "manager replied without table");
+	uint64_t owner_epoch = owner.epoch;
+	uint64_t our_epoch = routing_index.table().epoch;
+	log_line("WARN", "Misrouted request: storage is at epoch " + std::to_string(owner_epoch) + ", we are at " + std::to_string(our_epoch));
+	// a storage node behind us will catch up through its own subscription
+	if (owner_epoch <= our_epoch) {
 		return false;
 	}
-	size_t parsed_factor = 1;
-	routing_table = parse_table_payload(payload, parsed_factor);
-	replication_factor = std::max<size_t>(1, parsed_factor);
-	std::sort(routing_table.begin(), routing_table.end(), [](const StorageNodeInfo &lhs, const StorageNodeInfo &rhs) {
-		return lhs.token < rhs.token;
-	});
-	log_line("INFO", "Routing table now has " + std::to_string(routing_table.size()) + " nodes with replication " + std::to_string(replication_factor));
-	log_line("INFO", "Routing table detail: " + describe_table(routing_table));
-	return !routing_table.empty();
+	return refresh_table(owner_epoch) && routing_index.table().epoch > our_epoch;
 }
 
 // This verifies the key size.
@@ -125,13 +177,8 @@ bool GTStoreClient::validate_key(const string &key) {
 
 // This verifies the value size.
 bool GTStoreClient::validate_value(const val_t &value) {
-	size_t total = 0;
-	for (size_t i = 0; i < value.size(); ++i) {
-		total += value[i].size();
-		if (i + 1 < value.size()) {
-			total += 1; // comma separator
-		}
-	}
+	// the limit applies to the encoded form, which is what storage nodes check and keep
+	size_t total = encode_value(value).size();
 	if (total > MAX_VALUE_BYTE_PER_REQUEST) {
 		log_line("WARN", "value too large");
 		return false;
@@ -144,10 +191,19 @@ void GTStoreClient::init(int id) {
 
 		cout << "Inside GTStoreClient::init() for client " << id << "\n";
 		client_id = id;
+		read_spread = static_cast<size_t>(id);
+		table_source_cursor = static_cast<size_t>(id);
+		compress_min_bytes = DEFAULT_COMPRESS_MIN_BYTES;
+		const char *compress_env = std::getenv("GTSTORE_COMPRESS_MIN");
+		if (compress_env) {
+			// 0 turns compression off
+			compress_min_bytes = static_cast<size_t>(std::max(0, std::atoi(compress_env)));
+		}
 		setup_logging("client_" + std::to_string(client_id));
 		if (!refresh_table()) {
 			log_line("WARN", "client has empty routing table");
 		}
+		subscription = TableSubscription::start(manager_address, nullptr);
 }
 
 // This asks storage node for a key.
@@ -158,43 +214,59 @@ val_t GTStoreClient::get(string key) {
 		if (!validate_key(key)) {
 			return value;
 		}
-		size_t available_nodes = routing_table.size();
-		size_t max_attempts = std::min(replication_factor, std::max<size_t>(1, available_nodes));
-		for (size_t attempt = 0; attempt < max_attempts; ++attempt) {
-			StorageNodeInfo node = pick_node_for_attempt(key, attempt);
-			if (node.node_id.empty()) {
-				if (!refresh_table()) {
-					break;
+		catch_up_with_subscription();
+		uint64_t key_hash = hash_key(key);
+		bool found = run_with_owner_refresh("get", [&]() {
+			size_t replicas = std::max<size_t>(1, routing_index.replica_count(key_hash));
+			size_t max_attempts = std::max(replicas, routing_index.read_count(key_hash));
+			// hot keys rotate their first replica so reads spread over the whole replica set; draining nodes come last
+			size_t first = routing_index.is_hot(key_hash) ? read_spread++ % replicas : 0;
+			for (size_t attempt = 0; attempt < max_attempts; ++attempt) {
+				StorageNodeInfo node = pick_node_for_attempt(key_hash, attempt < replicas ? (first + attempt) % replicas : attempt);
+				if (node.node_id.empty()) {
+					if (!refresh_table()) {
+						break;
+					}
+					continue;
 				}
-				continue;
-			}
-			NodeAddress addr = node.address;
-			log_line("INFO", "get attempt key=" + key + " target=" + node.node_id);
-			int fd = connect_to_host(addr);
-			if (fd < 0) {
-				log_line("ERROR", "get connect failed for " + node.node_id);
-				refresh_table();
-				continue;
-			}
-			if (!send_message(fd, MessageType::CLIENT_GET, key)) {
-				log_line("ERROR", "get send failed");
+				NodeAddress addr = node.address;
+				log_line("INFO", "get attempt key=" + key + " target=" + node.node_id);
+				int fd = connect_to_host(addr);
+				if (fd < 0) {
+					log_line("ERROR", "get connect failed for " + node.node_id);
+					continue;
+				}
+				if (!send_typed<MessageType::CLIENT_GET>(fd, {key})) {
+					log_line("ERROR", "get send failed");
+					close(fd);
+					continue;
+				}
+				MessageType type;
+				std::string payload;
+				uint16_t flags = 0;
+				bool ok = recv_message(fd, type, payload, flags);
 				close(fd);
-				refresh_table();
-				continue;
-			}
-			MessageType type;
-			std::string payload;
-			bool ok = recv_message(fd, type, payload);
-			close(fd);
-			if (ok && type == MessageType::GET_OK) {
-				value = parse_value(payload);
-				log_line("INFO", "get success key=" + key + " value=" + payload + " from=" + node.node_id);
-				std::cout << key << ", " << payload << ", " << node.node_id << std::endl;
-				return value;
+				if (ok && type == MessageType::STREAMED_VALUE) {
+					log_line("WARN", "get key=" + key + " holds a streamed value; read it with get_stream");
+					return PassOutcome::FAILED;
+				}
+				if (ok && type == MessageType::GET_OK) {
+					value = parse_value(payload, flags);
+					std::string shown = join(value, ',');
+					log_line("INFO", "get success key=" + key + " value=" + shown + " from=" + node.node_id);
+					std::cout << key << ", " << shown << ", " << node.node_id << std::endl;
+					return PassOutcome::DONE;
+				}
+				// only a misroute means our table is behind; start over on the newer one
+				if (ok && type == MessageType::WRONG_OWNER && refresh_on_wrong_owner(payload)) {
+					return PassOutcome::MISROUTED;
+				}
 			}
-			refresh_table();
+			return PassOutcome::FAILED;
+		});
+		if (!found) {
+			log_line("WARN", "get failed after retries");
 		}
-		log_line("WARN", "get failed after retries");
 		return value;
 }
 
@@ -209,61 +281,250 @@ bool GTStoreClient::put(string key, val_t value) {
 		if (!validate_key(key) || !validate_value(value)) {
 			return false;
 		}
-		std::string payload = key + "|" + serialize_value(value);
-		size_t available_nodes = routing_table.size();
-		size_t replicas = std::min(replication_factor, std::max<size_t>(1, available_nodes));
+		catch_up_with_subscription();
+		std::string encoded = serialize_value(value);
+		uint16_t flags = maybe_compress(encoded);
+		std::string payload = encode_message<MessageType::CLIENT_PUT>({key, encoded});
+		std::string value_slice = join(value, ',');
+		uint64_t key_hash = hash_key(key);
+		size_t replicas = routing_index.replica_count(key_hash);
 		if (replicas == 0) {
 			if (!refresh_table()) {
 				log_line("ERROR", "put failed: no routing info");
 				return false;
 			}
-			available_nodes = routing_table.size();
-			replicas = std::min(replication_factor, std::max<size_t>(1, available_nodes));
+			replicas = routing_index.replica_count(key_hash);
 			if (replicas == 0) {
 				return false;
 			}
 		}
 		size_t stored = 0;
 		bool printed_primary = false;
+		bool complete = run_with_owner_refresh("put", [&]() {
+			// a misroute rewrites every replica of the newer table; repeating a put is harmless
+			replicas = routing_index.replica_count(key_hash);
+			stored = 0;
+			for (size_t attempt = 0; attempt < replicas; ++attempt) {
+				StorageNodeInfo node = pick_node_for_attempt(key_hash, attempt);
+				if (node.node_id.empty()) {
+					if (!refresh_table()) {
+						break;
+					}
+					continue;
+				}
+				NodeAddress addr = node.address;
+				log_line("INFO", "put attempt key=" + key + " value=" + value_slice + " target=" + node.node_id);
+				int fd = connect_to_host(addr);
+				if (fd < 0) {
+					log_line("ERROR", "put connect failed for " + node.node_id);
+					continue;
+				}
+				bool ok = send_message(fd, MessageType::CLIENT_PUT, payload, flags);
+				MessageType type;
+				std::string resp;
+				bool answered = ok && recv_message(fd, type, resp);
+				bool ack = answered && type == MessageType::PUT_OK;
+				close(fd);
+				if (ack) {
+					++stored;
+					log_line("INFO", "put success key=" + key + " stored_on=" + node.node_id);
+					if (!printed_primary) {
+						std::cout << "OK, " << node.node_id << std::endl;
+						printed_primary = true;
+					}
+					if (stored == replicas) {
+						return PassOutcome::DONE;
+					}
+					continue;
+				}
+				if (answered && type == MessageType::WRONG_OWNER && refresh_on_wrong_owner(resp)) {
+					return PassOutcome::MISROUTED;
+				}
+			}
+			return PassOutcome::FAILED;
+		});
+		if (complete) {
+			log_line("INFO", "put stored on " + std::to_string(stored) + " replicas");
+			return true;
+		}
+		log_line("WARN", "put stored on " + std::to_string(stored) + " of " + std::to_string(replicas) + " replicas");
+		return false;
+}
+
+// This opens one connection per replica of the key and starts a streamed put on each.
+// A misroute refreshes the table and starts over; false when no replica is ready.
+bool GTStoreClient::open_stream_targets(const string &key, uint64_t key_hash, vector<std::pair<StorageNodeInfo, int>> &targets) {
+	if (routing_index.replica_count(key_hash) == 0) {
+		refresh_table();
+	}
+	return run_with_owner_refresh("put_stream", [&]() {
+		size_t replicas = routing_index.replica_count(key_hash);
 		for (size_t attempt = 0; attempt < replicas; ++attempt) {
-			StorageNodeInfo node = pick_node_for_attempt(key, attempt);
+			StorageNodeInfo node = pick_node_for_attempt(key_hash, attempt);
 			if (node.node_id.empty()) {
-				if (!refresh_table()) {
-					break;
-				}
 				continue;
 			}
-			NodeAddress addr = node.address;
-			size_t sep_pos = payload.find('|');
-			std::string value_slice = (sep_pos == std::string::npos) ? payload : payload.substr(sep_pos + 1);
-			log_line("INFO", "put attempt key=" + key + " value=" + value_slice + " target=" + node.node_id);
-			int fd = connect_to_host(addr);
+			int fd = connect_to_host(node.address);
 			if (fd < 0) {
-				log_line("ERROR", "put connect failed for " + node.node_id);
-				refresh_table();
+				log_line("ERROR", "put_stream connect failed for " + node.node_id);
 				continue;
 			}
-			bool ok = send_message(fd, MessageType::CLIENT_PUT, payload);
 			MessageType type;
-			std::string resp;
-			bool ack = ok && recv_message(fd, type, resp) && type == MessageType::PUT_OK;
+			std::string reply;
+			bool answered = send_typed<MessageType::STREAM_PUT>(fd, {key}) && recv_message(fd, type, reply);
+			if (answered && type == MessageType::STREAM_READY) {
+				targets.emplace_back(node, fd);
+				continue;
+			}
 			close(fd);
+			if (answered && type == MessageType::WRONG_OWNER && refresh_on_wrong_owner(reply)) {
+				for (auto &target : targets) {
+					close(target.second);
+				}
+				targets.clear();
+				return PassOutcome::MISROUTED;
+			}
+		}
+		return targets.empty() ? PassOutcome::FAILED : PassOutcome::DONE;
+	});
+}
+
+// This stores a value of any size up to MAX_STREAM_VALUE_BYTES by reading the source once, in STREAM_CHUNK_BYTES
+// pieces, and sending each piece to every replica back to back without waiting for per-chunk acks. A manifest
+// (chunk count, length, CRC32C) closes the stream and each replica acks once. The source cannot be rewound, so a
+// replica lost mid-stream is not retried and the put reports false.
+bool GTStoreClient::put_stream(const string &key, std::istream &source) {
+
+		cout << "Inside GTStoreClient::put_stream() for client: " << client_id << " key: " << key << "\n";
+		if (!validate_key(key)) {
+			return false;
+		}
+		catch_up_with_subscription();
+		uint64_t key_hash = hash_key(key);
+		vector<std::pair<StorageNodeInfo, int>> targets;
+		if (!open_stream_targets(key, key_hash, targets)) {
+			log_line("ERROR", "put_stream found no ready replica for key=" + key);
+			return false;
+		}
+		size_t replicas = routing_index.replica_count(key_hash);
+		std::string chunk(STREAM_CHUNK_BYTES, '\0');
+		StreamManifest manifest{0, 0, 0};
+		bool too_large = false;
+		while (source) {
+			source.read(&chunk[0], static_cast<std::streamsize>(chunk.size()));
+			size_t got = static_cast<size_t>(source.gcount());
+			if (got == 0) {
+				break;
+			}
+			if (manifest.total_bytes + got > MAX_STREAM_VALUE_BYTES) {
+				too_large = true;
+				break;
+			}
+			// only the final read comes up short
+			chunk.resize(got);
+			manifest.checksum = crc32c_extend(manifest.checksum, chunk.data(), chunk.size());
+			manifest.total_bytes += got;
+			++manifest.chunk_count;
+			for (auto &target : targets) {
+				if (target.second >= 0 && !send_message(target.second, MessageType::STREAM_CHUNK, chunk)) {
+					log_line("ERROR", "put_stream lost " + target.first.node_id + " after " + std::to_string(manifest.total_bytes) + " bytes");
+					close(target.second);
+					target.second = -1;
+				}
+			}
+		}
+		if (too_large) {
+			log_line("WARN", "put_stream value exceeds " + std::to_string(MAX_STREAM_VALUE_BYTES) + " bytes");
+		}
+		std::string encoded = encode_message<MessageType::STREAM_END>(manifest);
+		size_t stored = 0;
+		for (auto &target : targets) {
+			if (target.second < 0) {
+				continue;
+			}
+			MessageType type;
+			std::string resp;
+			bool ack = !too_large && send_message(target.second, MessageType::STREAM_END, encoded) && recv_message(target.second, type, resp) && type == MessageType::PUT_OK;
+			close(target.second);
 			if (ack) {
+				if (stored == 0) {
+					std::cout << "OK, " << target.first.node_id << std::endl;
+				}
 				++stored;
-				log_line("INFO", "put success key=" + key + " stored_on=" + node.node_id);
-				if (!printed_primary) {
-					std::cout << "OK, " << node.node_id << std::endl;
-					printed_primary = true;
+				log_line("INFO", "put_stream success key=" + key + " bytes=" + std::to_string(manifest.total_bytes) + " stored_on=" + target.first.node_id);
+			}
+		}
+		if (stored == replicas) {
+			return true;
+		}
+		log_line("WARN", "put_stream stored on " + std::to_string(stored) + " of " + std::to_string(replicas) + " replicas");
+		return false;
+}
+
+// This reads a streamed value into the sink chunk by chunk, checking it against the manifest that ends the stream.
+// Replicas are tried in turn until data starts to flow; after that a broken stream returns false and the sink
+// holds a partial value.
+bool GTStoreClient::get_stream(const string &key, std::ostream &sink) {
+
+		cout << "Inside GTStoreClient::get_stream() for client: " << client_id << " key: " << key << "\n";
+		if (!validate_key(key)) {
+			return false;
+		}
+		catch_up_with_subscription();
+		uint64_t key_hash = hash_key(key);
+		bool broken = false;
+		bool delivered = run_with_owner_refresh("get_stream", [&]() {
+			size_t replicas = std::max<size_t>(1, routing_index.replica_count(key_hash));
+			size_t max_attempts = std::max(replicas, routing_index.read_count(key_hash));
+			size_t first = routing_index.is_hot(key_hash) ? read_spread++ % replicas : 0;
+			for (size_t attempt = 0; attempt < max_attempts; ++attempt) {
+				StorageNodeInfo node = pick_node_for_attempt(key_hash, attempt < replicas ? (first + attempt) % replicas : attempt);
+				if (node.node_id.empty()) {
+					if (!refresh_table()) {
+						break;
+					}
+					continue;
 				}
-				if (stored == replicas) {
-					log_line("INFO", "put stored on " + std::to_string(stored) + " replicas");
-					return true;
+				int fd = connect_to_host(node.address);
+				if (fd < 0) {
+					log_line("ERROR", "get_stream connect failed for " + node.node_id);
+					continue;
+				}
+				MessageType type = MessageType::ERROR;
+				std::string frame;
+				StreamManifest received{0, 0, 0};
+				bool ok = send_typed<MessageType::STREAM_GET>(fd, {key});
+				while (ok && (ok = recv_message(fd, type, frame)) && type == MessageType::STREAM_CHUNK) {
+					received.checksum = crc32c_extend(received.checksum, frame.data(), frame.size());
+					received.total_bytes += frame.size();
+					++received.chunk_count;
+					sink.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+				}
+				close(fd);
+				StreamManifest manifest;
+				if (ok && type == MessageType::STREAM_END && decode_message<MessageType::STREAM_END>(frame, manifest) && manifest.chunk_count == received.chunk_count &&
+				    manifest.total_bytes == received.total_bytes && manifest.checksum == received.checksum) {
+					log_line("INFO", "get_stream success key=" + key + " bytes=" + std::to_string(received.total_bytes) + " from=" + node.node_id);
+					std::cout << key << ", <" << received.total_bytes << " bytes>, " << node.node_id << std::endl;
+					return PassOutcome::DONE;
+				}
+				if (received.chunk_count > 0) {
+					log_line("ERROR", "get_stream from " + node.node_id + " broke off after " + std::to_string(received.total_bytes) + " bytes");
+					broken = true;
+					return PassOutcome::FAILED;
+				}
+				if (ok && type == MessageType::WRONG_OWNER && refresh_on_wrong_owner(frame)) {
+					return PassOutcome::MISROUTED;
 				}
-				continue;
 			}
-			refresh_table();
+			return PassOutcome::FAILED;
+		});
+		if (delivered) {
+			return sink.good();
+		}
+		if (!broken) {
+			log_line("WARN", "get_stream failed after retries");
 		}
-		log_line("WARN", "put stored on " + std::to_string(stored) + " of " + std::to_string(replicas) + " replicas");
 		return false;
 }
 
@@ -272,18 +533,20 @@ void GTStoreClient::finalize() {
 
 		cout << "Inside GTStoreClient::finalize() for client " << client_id << "\n";
 		log_line("INFO", "client finalize called");
-
-		//note: no cleanup is done in this implementation....
+		if (subscription) {
+			subscription->stop();
+			subscription.reset();
+		}
 }
 
 // This returns the current routing table snapshot.
 std::vector<StorageNodeInfo> GTStoreClient::current_table_snapshot() const {
-	return routing_table;
+	return routing_index.entries();
 }
 
 // This exposes the routing pick logic for tests.
 StorageNodeInfo GTStoreClient::debug_pick_for_test(const std::string &key, size_t attempt) {
-	return pick_node_for_attempt(key, attempt);
+	return pick_node_for_attempt(hash_key(key), attempt);
 }
 
 // This returns the last known replication factor.
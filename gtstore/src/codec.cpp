@@ -0,0 +1,86 @@
+#include "codec.hpp"
+
+namespace {
+// a 64-bit varint never needs more than ten bytes
+const int MAX_VARINT_BYTES = 10;
+}
+
+// This appends an unsigned LEB128 varint.
+void put_varint(std::string &out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// This reads a varint at pos and advances pos; false on truncated or overlong input.
+bool get_varint(std::string_view in, size_t &pos, uint64_t &value) {
+    value = 0;
+    for (int i = 0; i < MAX_VARINT_BYTES && pos < in.size(); ++i) {
+        uint8_t byte = static_cast<uint8_t>(in[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << (7 * i);
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// This encodes value elements, sizing the buffer once.
+std::string encode_value(const std::vector<std::string> &elements) {
+    size_t total = MAX_VARINT_BYTES;
+    for (const auto &element : elements) {
+        total += MAX_VARINT_BYTES + element.size();
+    }
+    std::string out;
+    out.reserve(total);
+    put_varint(out, elements.size());
+    for (const auto &element : elements) {
+        put_varint(out, element.size());
+        out.append(element);
+    }
+    return out;
+}
+
+// This decodes an encoded value in one pass. Lengths are checked against the bytes left before anything
+// is allocated, so a corrupt count cannot make it reserve more than the payload could hold.
+bool decode_value(const std::string &encoded, std::vector<std::string> &elements) {
+    elements.clear();
+    size_t pos = 0;
+    uint64_t count = 0;
+    if (!get_varint(encoded, pos, count) || count > encoded.size() - pos) {
+        return false;
+    }
+    elements.reserve(static_cast<size_t>(count));
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t length = 0;
+        if (!get_varint(encoded, pos, length) || length > encoded.size() - pos) {
+            elements.clear();
+            return false;
+        }
+        elements.emplace_back(encoded, pos, static_cast<size_t>(length));
+        pos += static_cast<size_t>(length);
+    }
+    if (pos != encoded.size()) {
+        elements.clear();
+        return false;
+    }
+    return true;
+}
+
+// This renders an encoded value comma-joined for logs and console output.
+std::string describe_value(const std::string &encoded) {
+    std::vector<std::string> elements;
+    if (!decode_value(encoded, elements)) {
+        return "<" + std::to_string(encoded.size()) + " bytes>";
+    }
+    std::string out;
+    for (size_t i = 0; i < elements.size(); ++i) {
+        if (i > 0) {
+            out.push_back(',');
+        }
+        out.append(elements[i]);
+    }
+    return out;
+}
@@ -0,0 +1,30 @@
+#ifndef GTSTORE_CODEC_HPP
+#define GTSTORE_CODEC_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// NEWLY ADDED: binary value encoding.
+// A value is a varint element count followed by each element as a varint
+// length and its raw bytes, so elements may hold any byte, commas and empty
+// strings included. Storage nodes keep the encoded value as is; how it is
+// framed inside a put is up to the message schema (see messages.hpp).
+
+// This appends an unsigned LEB128 varint.
+void put_varint(std::string &out, uint64_t value);
+
+// This reads a varint at pos and advances pos; false on truncated or overlong input.
+bool get_varint(std::string_view in, size_t &pos, uint64_t &value);
+
+// This encodes value elements.
+std::string encode_value(const std::vector<std::string> &elements);
+
+// This decodes an encoded value in one pass into elements; false when malformed.
+bool decode_value(const std::string &encoded, std::vector<std::string> &elements);
+
+// This renders an encoded value comma-joined for logs and console output.
+std::string describe_value(const std::string &encoded);
+
+#endif
@@ -0,0 +1,114 @@
+#include "crc32c.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define GTSTORE_CRC32C_X86 1
+#endif
+
+namespace {
+// reflected Castagnoli polynomial
+const uint32_t POLY = 0x82F63B78U;
+
+// NEWLY ADDED: slicing-by-8 lookup tables, built once
+struct SoftwareTables {
+    uint32_t table[8][256];
+
+    SoftwareTables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? POLY : 0);
+            }
+            table[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i) {
+            for (int k = 1; k < 8; ++k) {
+                table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+const SoftwareTables &tables() {
+    static const SoftwareTables built;
+    return built;
+}
+
+#ifdef GTSTORE_CRC32C_X86
+// This runs the SSE4.2 crc32 instruction over the buffer.
+__attribute__((target("sse4.2")))
+uint32_t crc32c_sse42(uint32_t crc, const uint8_t *bytes, size_t length) {
+    uint32_t state = ~crc;
+#if defined(__x86_64__)
+    uint64_t wide = state;
+    while (length >= 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        wide = _mm_crc32_u64(wide, word);
+        bytes += 8;
+        length -= 8;
+    }
+    state = static_cast<uint32_t>(wide);
+#endif
+    while (length > 0) {
+        state = _mm_crc32_u8(state, *bytes++);
+        --length;
+    }
+    return ~state;
+}
+
+// This checks the CPU once.
+bool detect_sse42() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+}
+#endif
+}
+
+// This computes the CRC32C with the slicing-by-8 tables.
+uint32_t crc32c_software(uint32_t crc, const void *data, size_t length) {
+    const SoftwareTables &t = tables();
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    uint32_t state = ~crc;
+    while (length >= 8) {
+        uint32_t low = state ^ (static_cast<uint32_t>(bytes[0]) | static_cast<uint32_t>(bytes[1]) << 8 |
+                                static_cast<uint32_t>(bytes[2]) << 16 | static_cast<uint32_t>(bytes[3]) << 24);
+        state = t.table[7][low & 0xFF] ^ t.table[6][(low >> 8) & 0xFF] ^ t.table[5][(low >> 16) & 0xFF] ^
+                t.table[4][low >> 24] ^ t.table[3][bytes[4]] ^ t.table[2][bytes[5]] ^ t.table[1][bytes[6]] ^
+                t.table[0][bytes[7]];
+        bytes += 8;
+        length -= 8;
+    }
+    while (length > 0) {
+        state = (state >> 8) ^ t.table[0][(state ^ *bytes++) & 0xFF];
+        --length;
+    }
+    return ~state;
+}
+
+// This reports whether the hardware path is in use.
+bool crc32c_hardware() {
+#ifdef GTSTORE_CRC32C_X86
+    static const bool supported = detect_sse42();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+// This extends a running CRC32C over data, on the crc32 instruction when the CPU has it.
+uint32_t crc32c_extend(uint32_t crc, const void *data, size_t length) {
+#ifdef GTSTORE_CRC32C_X86
+    if (crc32c_hardware()) {
+        return crc32c_sse42(crc, static_cast<const uint8_t *>(data), length);
+    }
+#endif
+    return crc32c_software(crc, data, length);
+}
+
+// This computes the CRC32C of one buffer.
+uint32_t crc32c(const void *data, size_t length) {
+    return crc32c_extend(0, data, length);
+}
@@ -0,0 +1,24 @@
+#ifndef GTSTORE_CRC32C_HPP
+#define GTSTORE_CRC32C_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// NEWLY ADDED: CRC32C (Castagnoli) for frame checksums.
+// On x86 CPUs with SSE4.2 it runs on the crc32 instruction, eight bytes per
+// step; elsewhere a slicing-by-8 table does the same work in software. Both
+// give identical results, so peers may use either.
+
+// This extends a running CRC32C over data; start with crc = 0.
+uint32_t crc32c_extend(uint32_t crc, const void *data, size_t length);
+
+// This computes the CRC32C of one buffer.
+uint32_t crc32c(const void *data, size_t length);
+
+// This reports whether the hardware path is in use.
+bool crc32c_hardware();
+
+// This computes the CRC32C in software only; used as the fallback and to check the hardware path.
+uint32_t crc32c_software(uint32_t crc, const void *data, size_t length);
+
+#endif
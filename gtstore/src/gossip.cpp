@@ -0,0 +1,404 @@
+#include "gossip.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <random>
+#include <sys/time.h>
+#include <thread>
+
+using namespace gtstore_utils;
+
+namespace {
+const auto PROTOCOL_PERIOD = std::chrono::milliseconds(1000);
+const auto ACK_TIMEOUT = std::chrono::milliseconds(300);
+const size_t INDIRECT_PROBES = 3;
+const size_t MAX_PIGGYBACK = 6;
+const size_t MAX_DATAGRAM = 8192;
+// room for the header and a few piggybacked rows, so building a datagram rarely reallocates
+const size_t DATAGRAM_RESERVE = 256;
+
+// This is the SWIM lambda * log(n) factor: periods a suspect gets to refute and times an update is resent.
+uint32_t log_rounds(size_t group_size) {
+    return 3 * static_cast<uint32_t>(std::ceil(std::log2(static_cast<double>(group_size) + 2.0)));
+}
+}
+
+// This binds the UDP socket and starts the protocol and receive threads.
+std::shared_ptr<GossipMembership> GossipMembership::start(const std::string &self_id, const NodeAddress &self_address) {
+    std::shared_ptr<GossipMembership> self(new GossipMembership());
+    self->self_id = self_id;
+    self->self_address = self_address;
+    // a restarted node must outrank whatever the group remembers about its previous life
+    self->self_incarnation = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        log_line("ERROR", "gossip socket failed");
+        return nullptr;
+    }
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(self_address.port);
+    inet_pton(AF_INET, self_address.host.c_str(), &addr.sin_addr);
+    if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) < 0) {
+        log_line("ERROR", "gossip bind failed on port " + std::to_string(self_address.port));
+        close(fd);
+        return nullptr;
+    }
+    // lets the receive thread notice stop() without a wake-up datagram
+    timeval receive_timeout{};
+    receive_timeout.tv_usec = 200000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &receive_timeout, sizeof(receive_timeout));
+    self->socket_fd = fd;
+    std::thread(&GossipMembership::receive_loop, self).detach();
+    std::thread(&GossipMembership::protocol_loop, self).detach();
+    log_line("INFO", "Gossip membership started on udp port " + std::to_string(self_address.port));
+    return self;
+}
+
+// This adds peers listed in the routing table and forgets peers that left it.
+void GossipMembership::observe_table(const std::vector<StorageNodeInfo> &nodes) {
+    std::lock_guard<std::mutex> guard(state_mutex);
+    std::unordered_map<std::string, NodeAddress> listed;
+    for (const auto &node : nodes) {
+        if (node.node_id != self_id) {
+            listed.emplace(node.node_id, node.address);
+        }
+    }
+    auto it = members.begin();
+    while (it != members.end()) {
+        if (listed.count(it->first) == 0) {
+            pending_updates.erase(it->first);
+            it = members.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    for (const auto &entry : listed) {
+        if (members.count(entry.first) == 0) {
+            members[entry.first] = Member{entry.second, State::ALIVE, 0, std::chrono::steady_clock::time_point()};
+        }
+    }
+    // announce ourselves so peers that seeded us from an older table learn our incarnation
+    enqueue_update(self_id);
+}
+
+// This lists peers the group has declared dead.
+std::vector<std::string> GossipMembership::dead_members() const {
+    std::lock_guard<std::mutex> guard(state_mutex);
+    std::vector<std::string> dead;
+    for (const auto &entry : members) {
+        if (entry.second.state == State::DEAD) {
+            dead.push_back(entry.first);
+        }
+    }
+    return dead;
+}
+
+// This stops both threads and closes the socket.
+void GossipMembership::stop() {
+    running = false;
+    ack_arrived.notify_all();
+}
+
+// This runs one probe per protocol period.
+void GossipMembership::protocol_loop(std::shared_ptr<GossipMembership> self) {
+    while (self->running) {
+        auto period_start = std::chrono::steady_clock::now();
+        self->expire_suspects();
+        self->expire_relays();
+        self->probe_once();
+        std::this_thread::sleep_until(period_start + PROTOCOL_PERIOD);
+    }
+    close(self->socket_fd);
+}
+
+// This receives datagrams until stopped.
+void GossipMembership::receive_loop(std::shared_ptr<GossipMembership> self) {
+    std::string buffer(MAX_DATAGRAM, '\0');
+    while (self->running) {
+        sockaddr_in from{};
+        socklen_t from_len = sizeof(from);
+        ssize_t got = recvfrom(self->socket_fd, &buffer[0], buffer.size(), 0, reinterpret_cast<sockaddr *>(&from), &from_len);
+        if (got <= 0) {
+            continue;
+        }
+        char host[INET_ADDRSTRLEN] = {0};
+        inet_ntop(AF_INET, &from.sin_addr, host, sizeof(host));
+        self->handle_datagram(buffer.substr(0, static_cast<size_t>(got)), NodeAddress{host, ntohs(from.sin_port)});
+    }
+}
+
+// This pings the next peer directly, then through helpers, and suspects it if nobody gets an ack.
+void GossipMembership::probe_once() {
+    std::unique_lock<std::mutex> lock(state_mutex);
+    std::string target = next_probe_target();
+    if (target.empty()) {
+        return;
+    }
+    uint64_t seq = next_seq++;
+    acked[seq] = false;
+    send_to(members[target].address, "ping", seq, target);
+    auto deadline = std::chrono::steady_clock::now() + ACK_TIMEOUT;
+    ack_arrived.wait_until(lock, deadline, [&]() { return acked[seq] || !running; });
+    if (!acked[seq]) {
+        for (const auto &helper : pick_helpers(target, INDIRECT_PROBES)) {
+            send_to(members[helper].address, "pingreq", seq, target);
+        }
+        // indirect acks may arrive until the period is nearly over
+        deadline = std::chrono::steady_clock::now() + (PROTOCOL_PERIOD - ACK_TIMEOUT) * 2 / 3;
+        ack_arrived.wait_until(lock, deadline, [&]() { return acked[seq] || !running; });
+    }
+    bool answered = acked[seq];
+    acked.erase(seq);
+    auto it = members.find(target);
+    if (answered || it == members.end() || it->second.state != State::ALIVE) {
+        return;
+    }
+    it->second.state = State::SUSPECT;
+    it->second.suspected_at = std::chrono::steady_clock::now();
+    enqueue_update(target);
+    log_line("WARN", "Gossip suspects " + target + " after direct and indirect probes failed");
+}
+
+// This declares suspects dead once they had time to refute.
+void GossipMembership::expire_suspects() {
+    std::lock_guard<std::mutex> guard(state_mutex);
+    auto timeout = PROTOCOL_PERIOD * std::max<uint32_t>(3, log_rounds(members.size()) / 3);
+    auto now = std::chrono::steady_clock::now();
+    for (auto &entry : members) {
+        if (entry.second.state == State::SUSPECT && now - entry.second.suspected_at > timeout) {
+            entry.second.state = State::DEAD;
+            enqueue_update(entry.first);
+            log_line("WARN", "Gossip declares " + entry.first + " dead");
+        }
+    }
+}
+
+// This forgets indirect probes whose target never answered; the requester gave up on them already.
+void GossipMembership::expire_relays() {
+    std::lock_guard<std::mutex> guard(state_mutex);
+    auto now = std::chrono::steady_clock::now();
+    auto it = relays.begin();
+    while (it != relays.end()) {
+        if (now > it->second.deadline) {
+            it = relays.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// This handles one "kind|sender|seq|target|updates" datagram.
+void GossipMembership::handle_datagram(const std::string &datagram, const NodeAddress &from) {
+    std::vector<std::string_view> fields;
+    split_view(datagram, '|', fields);
+    uint64_t seq = 0;
+    if (fields.size() < 4 || !parse_u64(fields[2], seq)) {
+        return;
+    }
+    std::string_view kind = fields[0];
+    std::string target(fields[3]);
+    std::lock_guard<std::mutex> guard(state_mutex);
+    if (fields.size() >= 5) {
+        std::vector<std::string_view> rows;
+        std::vector<std::string_view> parts;
+        split_view(fields[4], ';', rows);
+        for (std::string_view row : rows) {
+            split_view(row, ',', parts);
+            uint64_t port = 0;
+            uint64_t state = 0;
+            uint64_t incarnation = 0;
+            if (parts.size() != 5 || !parse_u64(parts[2], port) || port > UINT16_MAX || !parse_u64(parts[3], state) ||
+                state > static_cast<uint64_t>(State::DEAD) || !parse_u64(parts[4], incarnation)) {
+                continue;
+            }
+            NodeAddress address{std::string(parts[1]), static_cast<uint16_t>(port)};
+            apply_update(std::string(parts[0]), address, static_cast<State>(state), incarnation);
+        }
+    }
+    if (kind == "ping") {
+        send_to(from, "ack", seq, target);
+    } else if (kind == "pingreq") {
+        auto it = members.find(target);
+        if (it == members.end()) {
+            return;
+        }
+        uint64_t relay_seq = next_seq++;
+        // the requester stops listening before its protocol period ends
+        relays[relay_seq] = Relay{from, seq, std::chrono::steady_clock::now() + PROTOCOL_PERIOD};
+        send_to(it->second.address, "ping", relay_seq, target);
+    } else if (kind == "ack") {
+        auto relay = relays.find(seq);
+        if (relay != relays.end()) {
+            send_to(relay->second.requester, "ack", relay->second.requester_seq, target);
+            relays.erase(relay);
+            return;
+        }
+        auto waiting = acked.find(seq);
+        if (waiting != acked.end()) {
+            waiting->second = true;
+            ack_arrived.notify_all();
+        }
+    }
+}
+
+// This merges a membership update using SWIM's incarnation rules: ALIVE needs a newer incarnation, SUSPECT and
+// DEAD win at an equal or newer one. Caller holds state_mutex.
+void GossipMembership::apply_update(const std::string &node_id, const NodeAddress &address, State state, uint64_t incarnation) {
+    if (node_id == self_id) {
+        // refute any suspect or dead rumour: outbid it so our ALIVE overrides it everywhere
+        if (state != State::ALIVE) {
+            self_incarnation = std::max(self_incarnation, incarnation) + 1;
+            enqueue_update(self_id);
+            log_line("WARN", "Gossip refuted suspicion with incarnation " + std::to_string(self_incarnation));
+        }
+        return;
+    }
+    auto it = members.find(node_id);
+    if (it == members.end()) {
+        if (state != State::DEAD) {
+            members[node_id] = Member{address, state, incarnation, std::chrono::steady_clock::now()};
+            enqueue_update(node_id);
+        }
+        return;
+    }
+    Member &member = it->second;
+    bool accept = false;
+    switch (state) {
+    case State::ALIVE:
+        accept = incarnation > member.incarnation;
+        break;
+    case State::SUSPECT:
+        accept = (member.state == State::ALIVE && incarnation >= member.incarnation) ||
+                 (member.state == State::SUSPECT && incarnation > member.incarnation);
+        break;
+    case State::DEAD:
+        // a stale death rumour must not bury a node that has since proven itself alive
+        accept = member.state != State::DEAD && incarnation >= member.incarnation;
+        break;
+    }
+    if (!accept) {
+        return;
+    }
+    if (state == State::SUSPECT && member.state != State::SUSPECT) {
+        member.suspected_at = std::chrono::steady_clock::now();
+    }
+    if (state != member.state) {
+        log_line("INFO", "Gossip marks " + node_id + (state == State::ALIVE ? " alive" : state == State::SUSPECT ? " suspect" : " dead"));
+    }
+    member.address = address;
+    member.state = state;
+    member.incarnation = std::max(member.incarnation, incarnation);
+    enqueue_update(node_id);
+}
+
+// This schedules the current state of a node for piggybacking. Caller holds state_mutex.
+void GossipMembership::enqueue_update(const std::string &node_id) {
+    pending_updates[node_id] = log_rounds(members.size());
+}
+
+// This appends the freshest pending updates to out and counts one transmission for each. Caller holds state_mutex.
+void GossipMembership::append_piggyback(std::string &out) {
+    std::vector<std::pair<uint32_t, std::string>> ranked;
+    for (const auto &entry : pending_updates) {
+        ranked.emplace_back(entry.second, entry.first);
+    }
+    size_t count = std::min(MAX_PIGGYBACK, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), std::greater<std::pair<uint32_t, std::string>>());
+    bool first = true;
+    for (size_t i = 0; i < count; ++i) {
+        const std::string &node_id = ranked[i].second;
+        const NodeAddress *address = &self_address;
+        int state = 0;
+        uint64_t incarnation = self_incarnation;
+        if (node_id != self_id) {
+            auto it = members.find(node_id);
+            if (it == members.end()) {
+                address = nullptr;
+            } else {
+                address = &it->second.address;
+                state = static_cast<int>(it->second.state);
+                incarnation = it->second.incarnation;
+            }
+        }
+        if (address) {
+            if (!first) {
+                out.push_back(';');
+            }
+            first = false;
+            out += node_id;
+            out.push_back(',');
+            out += address->host;
+            out.push_back(',');
+            out += std::to_string(address->port);
+            out.push_back(',');
+            out += std::to_string(state);
+            out.push_back(',');
+            out += std::to_string(incarnation);
+        }
+        if (--pending_updates[node_id] == 0) {
+            pending_updates.erase(node_id);
+        }
+    }
+}
+
+// This sends one datagram with piggybacked updates. Caller holds state_mutex.
+void GossipMembership::send_to(const NodeAddress &to, const std::string &kind, uint64_t seq, const std::string &target) {
+    std::string datagram;
+    datagram.reserve(DATAGRAM_RESERVE);
+    datagram += kind;
+    datagram.push_back('|');
+    datagram += self_id;
+    datagram.push_back('|');
+    datagram += std::to_string(seq);
+    datagram.push_back('|');
+    datagram += target;
+    datagram.push_back('|');
+    append_piggyback(datagram);
+    sockaddr_in dest{};
+    dest.sin_family = AF_INET;
+    dest.sin_port = htons(to.port);
+    if (inet_pton(AF_INET, to.host.c_str(), &dest.sin_addr) <= 0) {
+        return;
+    }
+    sendto(socket_fd, datagram.data(), datagram.size(), 0, reinterpret_cast<sockaddr *>(&dest), sizeof(dest));
+}
+
+// This walks peers in a shuffled round-robin order, reshuffling after each pass. Caller holds state_mutex.
+std::string GossipMembership::next_probe_target() {
+    for (size_t tries = 0; tries < 2; ++tries) {
+        while (probe_cursor < probe_order.size()) {
+            auto it = members.find(probe_order[probe_cursor++]);
+            if (it != members.end() && it->second.state != State::DEAD) {
+                return it->first;
+            }
+        }
+        probe_order.clear();
+        for (const auto &entry : members) {
+            probe_order.push_back(entry.first);
+        }
+        static thread_local std::mt19937 rng(std::random_device{}());
+        std::shuffle(probe_order.begin(), probe_order.end(), rng);
+        probe_cursor = 0;
+    }
+    return "";
+}
+
+// This picks up to count live peers other than the target to probe it indirectly. Caller holds state_mutex.
+std::vector<std::string> GossipMembership::pick_helpers(const std::string &target, size_t count) {
+    std::vector<std::string> candidates;
+    for (const auto &entry : members) {
+        if (entry.first != target && entry.second.state == State::ALIVE) {
+            candidates.push_back(entry.first);
+        }
+    }
+    static thread_local std::mt19937 rng(std::random_device{}());
+    std::shuffle(candidates.begin(), candidates.end(), rng);
+    if (candidates.size() > count) {
+        candidates.resize(count);
+    }
+    return candidates;
+}
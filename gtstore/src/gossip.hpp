@@ -0,0 +1,84 @@
+#ifndef GTSTORE_GOSSIP_HPP
+#define GTSTORE_GOSSIP_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "net_common.hpp"
+
+// NEWLY ADDED: SWIM-style membership among storage nodes over UDP.
+// Every protocol period a node pings one peer; if no ack arrives it asks a few
+// other peers to ping on its behalf, and only if those fail too does it
+// suspect the peer. Suspicion and death spread by piggybacking on pings and
+// acks, and a suspected node refutes by bumping its incarnation. Per-node cost
+// stays constant as the cluster grows. The UDP port equals the node's TCP port.
+class GossipMembership {
+public:
+    // This binds the UDP socket and starts the protocol and receive threads; nullptr on bind failure.
+    static std::shared_ptr<GossipMembership> start(const std::string &self_id, const NodeAddress &self_address);
+
+    // This adds peers listed in the routing table and forgets peers that left it.
+    void observe_table(const std::vector<StorageNodeInfo> &nodes);
+
+    // This lists peers the group has declared dead.
+    std::vector<std::string> dead_members() const;
+
+    // This stops both threads and closes the socket.
+    void stop();
+
+private:
+    enum class State : uint8_t { ALIVE = 0, SUSPECT = 1, DEAD = 2 };
+
+    struct Member {
+        NodeAddress address;
+        State state;
+        uint64_t incarnation;
+        std::chrono::steady_clock::time_point suspected_at;
+    };
+
+    // an indirect probe this node runs for someone else; dropped unanswered past the deadline
+    struct Relay {
+        NodeAddress requester;
+        uint64_t requester_seq;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    std::string self_id;
+    NodeAddress self_address;
+    uint64_t self_incarnation = 0;
+    int socket_fd = -1;
+    std::atomic<bool> running{true};
+
+    mutable std::mutex state_mutex;
+    std::condition_variable ack_arrived;
+    std::unordered_map<std::string, Member> members;
+    std::unordered_map<std::string, uint32_t> pending_updates;
+    std::unordered_map<uint64_t, bool> acked;
+    std::unordered_map<uint64_t, Relay> relays;
+    std::vector<std::string> probe_order;
+    size_t probe_cursor = 0;
+    uint64_t next_seq = 1;
+
+    static void protocol_loop(std::shared_ptr<GossipMembership> self);
+    static void receive_loop(std::shared_ptr<GossipMembership> self);
+
+    void probe_once();
+    void expire_suspects();
+    void expire_relays();
+    void handle_datagram(const std::string &datagram, const NodeAddress &from);
+    void apply_update(const std::string &node_id, const NodeAddress &address, State state, uint64_t incarnation);
+    void enqueue_update(const std::string &node_id);
+    void append_piggyback(std::string &out);
+    void send_to(const NodeAddress &to, const std::string &kind, uint64_t seq, const std::string &target);
+    std::string next_probe_target();
+    std::vector<std::string> pick_helpers(const std::string &target, size_t count);
+};
+
+#endif
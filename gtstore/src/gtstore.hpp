@@ -1,19 +1,31 @@
 #ifndef GTSTORE
 #define GTSTORE
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
+#include <deque>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <thread>
 #include <chrono>
 #include <unistd.h>
 #include <sys/wait.h>
 
+#include "messages.hpp"
 #include "net_common.hpp"
+#include "routing.hpp"
+#include "gossip.hpp"
+#include "phi_accrual.hpp"
+#include "sketch.hpp"
+#include "subscription.hpp"
+#include "timer_wheel.hpp"
 
 const std::string DEFAULT_MANAGER_HOST = "127.0.0.1";
 const uint16_t DEFAULT_MANAGER_PORT = 5000;
@@ -30,14 +42,23 @@ class GTStoreClient {
 	private:
 		int client_id;
 		val_t value;
-		vector<StorageNodeInfo> routing_table;
+		RoutingIndex routing_index;
 		NodeAddress manager_address;
 		size_t replication_factor;
-		StorageNodeInfo pick_primary(const string &key);
-		StorageNodeInfo pick_node_for_attempt(const string &key, size_t attempt);
-		val_t parse_value(const string &payload);
+		std::shared_ptr<TableSubscription> subscription;
+		size_t read_spread = 0;
+		size_t table_source_cursor = 0;
+		size_t compress_min_bytes = 0;
+		uint64_t hash_key(const string &key);
+		StorageNodeInfo pick_primary(uint64_t key_hash);
+		StorageNodeInfo pick_node_for_attempt(uint64_t key_hash, size_t attempt);
+		val_t parse_value(const string &payload, uint16_t flags);
 		string serialize_value(const val_t &value);
-		bool refresh_table();
+		uint16_t maybe_compress(string &encoded);
+		bool refresh_table(uint64_t min_epoch = 0);
+		void catch_up_with_subscription();
+		bool refresh_on_wrong_owner(const string &reply);
+		bool open_stream_targets(const string &key, uint64_t key_hash, vector<std::pair<StorageNodeInfo, int>> &targets);
 		bool validate_key(const string &key);
 		bool validate_value(const val_t &value);
 	public:
@@ -46,45 +67,134 @@ class GTStoreClient {
 		void finalize();
 		val_t get(string key);
 		bool put(string key, val_t value);
+		bool put_stream(const string &key, std::istream &source);
+		bool get_stream(const string &key, std::ostream &sink);
 		std::vector<StorageNodeInfo> current_table_snapshot() const;
 		StorageNodeInfo debug_pick_for_test(const std::string &key, size_t attempt);
 		size_t current_replication() const;
 };
 
+// NEWLY ADDED: one immutable version of the manager's routing table.
+// Writers publish a new one per change; readers hold a reference without locking.
+struct PublishedTable {
+	uint64_t epoch;
+	vector<StorageNodeInfo> nodes;
+	string payload;
+};
+
 class GTStoreManager {
 	private:
 		uint16_t listen_port;
 		int listen_fd;
+		// writers' copy under table_mutex; readers go through published_table
 		vector<StorageNodeInfo> node_table;
 		size_t replication_factor;
+		PlacementMode placement_mode;
+		size_t tokens_per_weight;
+		uint64_t table_epoch;
+		std::deque<TableDelta> table_history;
+		std::shared_ptr<const PublishedTable> published_table;
 		std::mutex table_mutex;
-		std::unordered_map<std::string, std::chrono::steady_clock::time_point> heartbeat_times;
+		std::unordered_map<std::string, PhiAccrualDetector> liveness;
+		std::unique_ptr<TimerWheel> liveness_deadlines;
+		double phi_threshold;
+		double phi_threshold_deviations;
+		std::unordered_map<uint64_t, std::chrono::steady_clock::time_point> hot_key_times;
+		std::unordered_map<std::string, uint64_t> node_loads;
+		std::unordered_map<std::string, uint32_t> keep_percent;
+		std::unordered_set<std::string> draining_nodes;
+		std::unordered_map<std::string, std::unordered_map<std::string, std::chrono::steady_clock::time_point>> gossip_reports;
+		double load_factor;
+		string state_path;
+		uint64_t persisted_epoch;
 		std::thread heartbeat_thread;
+		std::thread pusher_thread;
+		std::vector<int> new_subscribers;
+		bool push_pending;
+		std::mutex subscriber_mutex;
+		std::condition_variable subscriber_wakeup;
 		bool running;
-		void accept_loop();
+		void event_loop();
+		bool handle_message(int client_fd, MessageType type, const string &payload);
+		void add_subscriber(int client_fd);
+		void publish_table_epoch();
+		void push_epochs();
 		void handle_storage_register(const string &payload);
-		void handle_heartbeat(const string &payload);
-		vector<StorageNodeInfo> snapshot_nodes();
+		HeartbeatAction handle_heartbeat(const string &payload);
+		MessageType handle_decommission(const string &node_id, string &reply);
+		MessageType handle_drain_done(const string &node_id, string &reply);
+		bool drop_node(const string &node_id, vector<StorageNodeInfo> &removed_entries);
+		uint32_t free_jump_bucket();
+		bool confirm_gossip_death(const string &dead_id, const string &reporter, std::chrono::steady_clock::time_point now);
+		void record_heartbeat(const string &node_id, std::chrono::steady_clock::time_point now);
+		std::shared_ptr<const PublishedTable> current_table();
+		void publish_table();
+		std::vector<uint64_t> hot_key_list();
+		bool expire_hot_keys(std::chrono::steady_clock::time_point now);
+		std::vector<NodeLoadShare> load_share_list();
+		bool rebalance_load_shares();
+		std::vector<std::string> draining_list();
+		void record_table_change(const vector<StorageNodeInfo> &added, const vector<StorageNodeInfo> &removed);
+		MessageType build_sync_reply(uint64_t since_epoch, std::shared_ptr<const std::string> &payload);
+		void save_membership();
+		void load_membership();
 		void monitor_heartbeats();
 	public:
 		void init();
 };
 
+// NEWLY ADDED: a value as a storage node keeps it, still encoded and possibly compressed.
+// A streamed value keeps its encoded manifest in bytes and its data as the chunk list.
+struct StoredValue {
+	string bytes;
+	uint16_t flags;
+	std::shared_ptr<const vector<string>> chunks;
+	// the node's write sequence number when this value was stored; a drain resends keys written after its last pass
+	uint64_t seq;
+};
+
 class GTStoreStorage {
 	private:
 		uint16_t listen_port;
 		int listen_fd;
-		unordered_map<string, string> kv_store;
+		unordered_map<string, StoredValue> kv_store;
+		std::mutex store_mutex;
+		// both guarded by store_mutex; a sealed store takes no more writes while the node retires
+		uint64_t write_seq;
+		bool writes_sealed;
 		string storage_id;
+		uint32_t capacity_weight;
 		size_t replication_factor;
+		TableSnapshot table;
+		RoutingIndex ring;
+		std::mutex table_mutex;
+		std::shared_ptr<TableSubscription> subscription;
+		std::shared_ptr<GossipMembership> gossip;
+		std::unique_ptr<HotKeyTracker> hot_keys;
+		std::atomic<uint64_t> window_requests;
+		std::atomic<bool> draining;
+		std::mutex rebalance_mutex;
+		RoutingIndex handoff_ring;
+		uint64_t handoff_epoch;
 		std::thread heartbeat_thread;
-		bool running;
+		std::atomic<bool> running;
 		void register_with_manager();
+		void sync_table_from_manager(uint64_t announced_epoch);
 		void serve_clients();
-		void handle_put(int client_fd, const string &payload);
+		void handle_put(int client_fd, const string &payload, uint16_t flags);
 		void handle_get(int client_fd, const string &payload);
-		bool key_valid(const std::string &key);
+		void handle_table_request(int client_fd, MessageType type, const string &payload);
+		void handle_replica_put(int client_fd, const string &payload, uint16_t flags);
+		void handle_stream_put(int client_fd, const string &payload, uint16_t flags, bool handoff);
+		void handle_stream_get(int client_fd, const string &payload);
+		vector<StorageNodeInfo> handoff_targets(const string &key);
+		bool hand_off(const string &key, const StoredValue &value, uint16_t flags);
+		bool send_handoff(const StorageNodeInfo &target, const string &key, const StoredValue &value, uint16_t flags);
+		void rebalance_after_share_change(TableSnapshot before);
+		void drain_and_retire();
+		bool key_valid(std::string_view key);
 		bool value_valid(const std::string &value);
+		bool owns_key(const std::string &key, uint64_t &epoch, bool reading);
 		void heartbeat_loop();
 		void log_current_store();
 	public:
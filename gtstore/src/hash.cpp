@@ -0,0 +1,110 @@
+#include "hash.hpp"
+
+#include <cstring>
+
+namespace {
+const uint64_t SECRET[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+// This replaces a and b with the low and high halves of a * b.
+inline void multiply_128(uint64_t &a, uint64_t &b) {
+#if defined(__SIZEOF_INT128__)
+    __uint128_t product = static_cast<__uint128_t>(a) * b;
+    a = static_cast<uint64_t>(product);
+    b = static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t a_hi = a >> 32, a_lo = static_cast<uint32_t>(a);
+    uint64_t b_hi = b >> 32, b_lo = static_cast<uint32_t>(b);
+    uint64_t hh = a_hi * b_hi, hl = a_hi * b_lo, lh = a_lo * b_hi, ll = a_lo * b_lo;
+    uint64_t t = ll + (hl << 32);
+    uint64_t lo = t + (lh << 32);
+    uint64_t carry = (t < ll) + (lo < t);
+    uint64_t hi = hh + (hl >> 32) + (lh >> 32) + carry;
+    a = lo;
+    b = hi;
+#endif
+}
+
+inline uint64_t mix(uint64_t a, uint64_t b) {
+    multiply_128(a, b);
+    return a ^ b;
+}
+
+// This loads 8 bytes as a little-endian integer.
+inline uint64_t read64(const uint8_t *p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+// This loads 4 bytes as a little-endian integer.
+inline uint64_t read32(const uint8_t *p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+// This packs 1-3 bytes without branching on the exact length.
+inline uint64_t read_small(const uint8_t *p, size_t length) {
+    return (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[length >> 1]) << 8) | p[length - 1];
+}
+}
+
+// This computes wyhash over the buffer.
+uint64_t ring_hash(const void *data, size_t length, uint64_t seed) {
+    const uint8_t *p = static_cast<const uint8_t *>(data);
+    seed ^= mix(seed ^ SECRET[0], SECRET[1]);
+    uint64_t a;
+    uint64_t b;
+    if (length <= 16) {
+        // keys are at most MAX_KEY_BYTE_PER_REQUEST bytes, so this is the common path
+        if (length >= 4) {
+            size_t shift = (length >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + shift);
+            b = (read32(p + length - 4) << 32) | read32(p + length - 4 - shift);
+        } else if (length > 0) {
+            a = read_small(p, length);
+            b = 0;
+        } else {
+            a = 0;
+            b = 0;
+        }
+    } else {
+        size_t remaining = length;
+        if (remaining > 48) {
+            uint64_t seed1 = seed;
+            uint64_t seed2 = seed;
+            do {
+                seed = mix(read64(p) ^ SECRET[1], read64(p + 8) ^ seed);
+                seed1 = mix(read64(p + 16) ^ SECRET[2], read64(p + 24) ^ seed1);
+                seed2 = mix(read64(p + 32) ^ SECRET[3], read64(p + 40) ^ seed2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (remaining > 16) {
+            seed = mix(read64(p) ^ SECRET[1], read64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        a = read64(p + remaining - 16);
+        b = read64(p + remaining - 8);
+    }
+    a ^= SECRET[1];
+    b ^= seed;
+    multiply_128(a, b);
+    return mix(a ^ SECRET[0] ^ length, b ^ SECRET[1]);
+}
+
+// This hashes a whole string with the ring hash.
+uint64_t ring_hash(const std::string &value, uint64_t seed) {
+    return ring_hash(value.data(), value.size(), seed);
+}
@@ -0,0 +1,17 @@
+#ifndef GTSTORE_HASH_HPP
+#define GTSTORE_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// NEWLY ADDED: stable 64-bit hash used for every ring placement decision.
+// This is wyhash final4 (Wang Yi, public domain) with its default secret.
+// Input is read little-endian and the 128-bit multiply has a portable
+// fallback, so the same key maps to the same token on every toolchain.
+uint64_t ring_hash(const void *data, size_t length, uint64_t seed = 0);
+
+// This hashes a whole string with the ring hash.
+uint64_t ring_hash(const std::string &value, uint64_t seed = 0);
+
+#endif
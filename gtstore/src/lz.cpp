@@ -0,0 +1,145 @@
+#include "lz.hpp"
+#include "codec.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+const size_t MIN_MATCH = 4;
+const size_t MAX_OFFSET = 65535;
+const int HASH_BITS = 12;
+// the last bytes always go out as literals, so a match never reads past the end
+const size_t END_LITERALS = 5;
+
+// This reads four bytes for hashing and match checks.
+uint32_t read32(const char *at) {
+    uint32_t value;
+    std::memcpy(&value, at, sizeof(value));
+    return value;
+}
+
+// This hashes four bytes into a table slot.
+size_t slot(uint32_t sequence) {
+    return static_cast<size_t>((sequence * 2654435761U) >> (32 - HASH_BITS));
+}
+
+// This writes the extra bytes of a length that did not fit its nibble.
+void put_length(std::string &out, size_t length) {
+    while (length >= 255) {
+        out.push_back(static_cast<char>(255));
+        length -= 255;
+    }
+    out.push_back(static_cast<char>(length));
+}
+
+// This reads the extra bytes of a length whose nibble was 15.
+bool get_length(const std::string &block, size_t &pos, size_t &length) {
+    while (pos < block.size()) {
+        uint8_t byte = static_cast<uint8_t>(block[pos++]);
+        length += byte;
+        if (byte != 255) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// This emits one sequence: literal_length literals and, when match_length is at least four, a match.
+void put_sequence(std::string &out, const char *literal_start, size_t literal_length, size_t offset, size_t match_length) {
+    size_t match_code = match_length >= MIN_MATCH ? match_length - MIN_MATCH : 0;
+    uint8_t token = static_cast<uint8_t>((literal_length >= 15 ? 15 : literal_length) << 4);
+    token |= static_cast<uint8_t>(match_code >= 15 ? 15 : match_code);
+    out.push_back(static_cast<char>(token));
+    if (literal_length >= 15) {
+        put_length(out, literal_length - 15);
+    }
+    out.append(literal_start, literal_length);
+    if (match_length < MIN_MATCH) {
+        return;
+    }
+    out.push_back(static_cast<char>(offset & 0xFF));
+    out.push_back(static_cast<char>(offset >> 8));
+    if (match_code >= 15) {
+        put_length(out, match_code - 15);
+    }
+}
+}
+
+// This compresses a buffer into one block.
+std::string lz_compress(const std::string &input) {
+    std::string out;
+    out.reserve(input.size() + input.size() / 255 + 16);
+    put_varint(out, input.size());
+    const char *base = input.data();
+    size_t size = input.size();
+    size_t anchor = 0;
+    if (size > MIN_MATCH + END_LITERALS) {
+        std::vector<uint32_t> table(static_cast<size_t>(1) << HASH_BITS, 0);
+        size_t limit = size - END_LITERALS;
+        size_t pos = 1;
+        while (pos + MIN_MATCH <= limit) {
+            uint32_t sequence = read32(base + pos);
+            uint32_t candidate = table[slot(sequence)];
+            table[slot(sequence)] = static_cast<uint32_t>(pos);
+            if (candidate >= pos || pos - candidate > MAX_OFFSET || read32(base + candidate) != sequence) {
+                ++pos;
+                continue;
+            }
+            size_t match_length = MIN_MATCH;
+            while (pos + match_length < limit && base[candidate + match_length] == base[pos + match_length]) {
+                ++match_length;
+            }
+            put_sequence(out, base + anchor, pos - anchor, pos - candidate, match_length);
+            pos += match_length;
+            anchor = pos;
+        }
+    }
+    put_sequence(out, base + anchor, size - anchor, 0, 0);
+    return out;
+}
+
+// This expands a block into output; false when it is malformed or would exceed max_size.
+bool lz_decompress(const std::string &block, std::string &output, size_t max_size) {
+    size_t pos = 0;
+    uint64_t original = 0;
+    if (!get_varint(block, pos, original) || original > max_size) {
+        return false;
+    }
+    output.clear();
+    output.reserve(static_cast<size_t>(original));
+    while (pos < block.size()) {
+        uint8_t token = static_cast<uint8_t>(block[pos++]);
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !get_length(block, pos, literal_length)) {
+            return false;
+        }
+        if (literal_length > block.size() - pos || literal_length > original - output.size()) {
+            return false;
+        }
+        output.append(block, pos, literal_length);
+        pos += literal_length;
+        if (pos == block.size()) {
+            break;
+        }
+        if (block.size() - pos < 2) {
+            return false;
+        }
+        size_t offset = static_cast<uint8_t>(block[pos]) | (static_cast<size_t>(static_cast<uint8_t>(block[pos + 1])) << 8);
+        pos += 2;
+        size_t match_length = token & 0x0F;
+        if (match_length == 15 && !get_length(block, pos, match_length)) {
+            return false;
+        }
+        match_length += MIN_MATCH;
+        if (offset == 0 || offset > output.size() || match_length > original - output.size()) {
+            return false;
+        }
+        // matches may overlap their own output, so copy byte by byte
+        size_t from = output.size() - offset;
+        for (size_t i = 0; i < match_length; ++i) {
+            output.push_back(output[from + i]);
+        }
+    }
+    return output.size() == original;
+}
@@ -0,0 +1,21 @@
+#ifndef GTSTORE_LZ_HPP
+#define GTSTORE_LZ_HPP
+
+#include <cstddef>
+#include <string>
+
+// NEWLY ADDED: small in-tree LZ77 block codec in the LZ4 style.
+// A block is the varint original size followed by sequences of a token byte
+// (literal run length in the high nibble, match length minus four in the low
+// nibble, 15 meaning "more length bytes follow"), the literals, and a 2-byte
+// little-endian match offset. The last sequence carries literals only.
+// Matches are found through a single-probe hash table, which favours speed
+// over ratio; repetitive text still shrinks several times.
+
+// This compresses a buffer into one block.
+std::string lz_compress(const std::string &input);
+
+// This expands a block into output; false when it is malformed or would exceed max_size.
+bool lz_decompress(const std::string &block, std::string &output, size_t max_size);
+
+#endif
@@ -1,39 +1,108 @@
 #include "gtstore.hpp"
+#include "messages.hpp"
 #include "utils.hpp"
 
 #include <algorithm>
-#include <functional>
 #include <thread>
 #include <chrono>
 #include <cstdlib>
+#include <cstring>
 #include <sstream>
+#include <cerrno>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 
 using namespace gtstore_utils;
 
 namespace {
 const std::string COMPONENT_NAME = "manager";
-const int BACKLOG = 16;
+// one loop accepts for every node, so leave room for a burst of registrations
+const int BACKLOG = 128;
+const int MAX_EPOLL_EVENTS = 64;
+// storage nodes beat every two seconds; the detector starts from that guess
+const double HEARTBEAT_INTERVAL_SECONDS = 2.0;
+// deadlines live in a timer wheel; each sweep only sees the nodes that actually expired
+const auto LIVENESS_SWEEP = std::chrono::milliseconds(100);
+// phi 8 is roughly one false eviction in 10^8 checks; with gossip the manager is only the fallback
+const double DEFAULT_PHI_THRESHOLD = 8.0;
+const double GOSSIP_PHI_THRESHOLD = 16.0;
+// a gossip death report evicts a node once this many storage nodes sent one within the TTL,
+// or once the manager's own detector has reached the confirmation phi for it
+const size_t GOSSIP_DEAD_QUORUM = 2;
+const auto GOSSIP_REPORT_TTL = std::chrono::seconds(10);
+const double GOSSIP_CONFIRM_PHI = 3.0;
+// hot key expiry and load caps keep the heartbeat cadence
+const int SWEEPS_PER_MAINTENANCE = 20;
+// oldest table changes are dropped past this many epochs; older clients get a full table
+const size_t MAX_TABLE_HISTORY = 256;
+// ring tokens handed out per unit of declared capacity weight
+const size_t DEFAULT_TOKENS_PER_WEIGHT = 8;
+const int MAX_NODE_WEIGHT = 64;
+// a hot key stays in the table this long after the last storage node reported it
+const auto HOT_KEY_TTL = std::chrono::seconds(10);
+// bounded placement: default cap as a multiple of the average load per weight unit
+const double DEFAULT_LOAD_FACTOR = 1.25;
+// below this many requests per heartbeat window across the cluster the caps are lifted
+const uint64_t MIN_BALANCED_LOAD = 100;
+const uint32_t MIN_KEEP_PERCENT = 5;
+const uint32_t KEEP_STEP_PERCENT = 5;
+const double LOAD_RELEASE_RATIO = 0.8;
+// membership survives a manager restart through this file; GTSTORE_MANAGER_STATE="" turns it off
+const std::string DEFAULT_STATE_DIR = "state";
+const std::string DEFAULT_STATE_PATH = DEFAULT_STATE_DIR + "/manager.members";
+// the state file records an epoch this far ahead, so hot key and load share changes need no write
+// until the live epoch reaches it; a restart resumes past it and never reuses an epoch
+const uint64_t PERSISTED_EPOCH_RESERVE = 1024;
 
-// This formats the routing table for logging.
-std::string describe_nodes(const std::vector<StorageNodeInfo> &nodes) {
-	if (nodes.empty()) {
-		return "<empty>";
+// This sends a published full table; the payload is shared, never rebuilt per request.
+bool send_table(int client_fd, const std::shared_ptr<const PublishedTable> &table) {
+	log_line("INFO", "Sending routing table epoch=" + std::to_string(table->epoch) + " (" + std::to_string(table->payload.size()) + " bytes)");
+	return send_message(client_fd, MessageType::TABLE_PUSH, table->payload);
+}
+
+// This replaces path with contents so a crash leaves either the old file or the complete new one:
+// write a temp file, fsync it, rename it over path, then fsync the directory to keep the rename.
+bool write_file_durably(const std::string &path, const std::string &contents) {
+	std::string temp_path = path + ".tmp";
+	int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return false;
 	}
-	std::ostringstream out;
-	for (size_t i = 0; i < nodes.size(); ++i) {
-		out << nodes[i].node_id << "@" << nodes[i].address.host << ":" << nodes[i].address.port
-		    << " token=" << nodes[i].token;
-		if (i + 1 < nodes.size()) {
-			out << " | ";
+	size_t written = 0;
+	while (written < contents.size()) {
+		ssize_t got = write(fd, contents.data() + written, contents.size() - written);
+		if (got < 0 && errno == EINTR) {
+			continue;
 		}
+		if (got <= 0) {
+			close(fd);
+			return false;
+		}
+		written += static_cast<size_t>(got);
+	}
+	bool synced = fsync(fd) == 0;
+	close(fd);
+	if (!synced || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+		return false;
+	}
+	size_t slash = path.find_last_of('/');
+	std::string dir = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+	int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+	if (dir_fd < 0) {
+		return false;
 	}
-	return out.str();
+	synced = fsync(dir_fd) == 0;
+	close(dir_fd);
+	return synced;
 }
 
-bool send_table(int client_fd, const std::vector<StorageNodeInfo> &nodes, size_t replication_factor) {
-	log_line("INFO", "Sending routing table (rep=" + std::to_string(replication_factor) + "): " + describe_nodes(nodes));
-	std::string payload = build_table_payload(nodes, replication_factor);
-	return send_message(client_fd, MessageType::TABLE_PUSH, payload);
+// This keys a ring entry for delta bookkeeping.
+std::string entry_key(const StorageNodeInfo &node) {
+	return node.node_id + "/" + std::to_string(node.token);
 }
 }
 
@@ -43,7 +112,10 @@ void GTStoreManager::init() {
 	log_line("INFO", "Inside GTStoreManager::init()");
 	listen_port = DEFAULT_MANAGER_PORT;
 	replication_factor = 2;
+	table_epoch = 0;
+	persisted_epoch = 0;
 	running = true;
+	push_pending = false;
 	const char *env = std::getenv("GTSTORE_REPL");
 	if (env) {
 		int parsed = std::atoi(env);
@@ -51,8 +123,59 @@ void GTStoreManager::init() {
 			replication_factor = static_cast<size_t>(parsed);
 		}
 	}
+	tokens_per_weight = DEFAULT_TOKENS_PER_WEIGHT;
+	const char *vnodes_env = std::getenv("GTSTORE_VNODES");
+	if (vnodes_env) {
+		int parsed = std::atoi(vnodes_env);
+		if (parsed >= 1) {
+			tokens_per_weight = static_cast<size_t>(parsed);
+		}
+	}
+	placement_mode = PlacementMode::RING;
+	const char *placement_env = std::getenv("GTSTORE_PLACEMENT");
+	if (placement_env && *placement_env) {
+		placement_mode = parse_placement(placement_env);
+	}
+	const char *gossip_env = std::getenv("GTSTORE_GOSSIP");
+	phi_threshold = (!gossip_env || std::string(gossip_env) != "0") ? GOSSIP_PHI_THRESHOLD : DEFAULT_PHI_THRESHOLD;
+	const char *phi_env = std::getenv("GTSTORE_PHI_THRESHOLD");
+	if (phi_env) {
+		double parsed = std::atof(phi_env);
+		if (parsed > 0.0) {
+			phi_threshold = parsed;
+		}
+	}
+	phi_threshold_deviations = phi_deviations(phi_threshold);
+	liveness_deadlines.reset(new TimerWheel(LIVENESS_SWEEP, std::chrono::steady_clock::now()));
+	load_factor = DEFAULT_LOAD_FACTOR;
+	const char *load_env = std::getenv("GTSTORE_LOAD_FACTOR");
+	if (load_env) {
+		double parsed = std::atof(load_env);
+		if (parsed > 1.0) {
+			load_factor = parsed;
+		}
+	}
+	state_path = DEFAULT_STATE_PATH;
+	const char *state_env = std::getenv("GTSTORE_MANAGER_STATE");
+	if (state_env) {
+		state_path = state_env;
+	} else {
+		mkdir(DEFAULT_STATE_DIR.c_str(), 0755);
+	}
 	setup_logging(COMPONENT_NAME);
 	log_line("INFO", "Replication factor set to " + std::to_string(replication_factor));
+	log_line("INFO", "Placement mode set to " + placement_name(placement_mode) + ", " + std::to_string(tokens_per_weight) + " tokens per weight unit");
+	log_line("INFO", "Failure detector phi threshold set to " + std::to_string(phi_threshold));
+	if (placement_mode == PlacementMode::BOUNDED) {
+		log_line("INFO", "Load cap set to " + std::to_string(load_factor) + "x the average load");
+	}
+	load_membership();
+	{
+		std::lock_guard<std::mutex> guard(table_mutex);
+		if (!published_table) {
+			publish_table();
+		}
+	}
 	NodeAddress addr{DEFAULT_MANAGER_HOST, listen_port};
 	listen_fd = create_listen_socket(addr, BACKLOG);
 	if (listen_fd < 0) {
@@ -62,131 +185,736 @@ void GTStoreManager::init() {
 	log_line("INFO", "Manager listening on " + addr.host + ":" + std::to_string(addr.port));
 	heartbeat_thread = std::thread(&GTStoreManager::monitor_heartbeats, this);
 	heartbeat_thread.detach();
-	accept_loop();
+	pusher_thread = std::thread(&GTStoreManager::push_epochs, this);
+	pusher_thread.detach();
+	event_loop();
 }
 
-// This accepts client and storage sockets.
-void GTStoreManager::accept_loop() {
-	while (true) {
-		int client_fd = accept_client(listen_fd);
-		if (client_fd < 0) {
+// This multiplexes every manager connection on one epoll loop. Storage nodes keep
+// their heartbeat connection open, so liveness costs no accept or thread per beat.
+void GTStoreManager::event_loop() {
+	int epoll_fd = epoll_create1(0);
+	if (epoll_fd < 0) {
+		log_line("ERROR", "epoll_create1 failed");
+		return;
+	}
+	fcntl(listen_fd, F_SETFL, fcntl(listen_fd, F_GETFL, 0) | O_NONBLOCK);
+	epoll_event listen_event{};
+	listen_event.events = EPOLLIN;
+	listen_event.data.fd = listen_fd;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &listen_event);
+	// bytes received but not yet framed, per open connection
+	std::unordered_map<int, std::string> inbound;
+	epoll_event events[MAX_EPOLL_EVENTS];
+	while (running) {
+		int ready = epoll_wait(epoll_fd, events, MAX_EPOLL_EVENTS, -1);
+		if (ready < 0) {
+			if (errno != EINTR) {
+				log_line("ERROR", "epoll_wait failed");
+			}
 			continue;
 		}
-		std::thread([this, client_fd]() {
+		for (int i = 0; i < ready; ++i) {
+			int fd = events[i].data.fd;
+			if (fd == listen_fd) {
+				while (true) {
+					int client_fd = accept(listen_fd, nullptr, nullptr);
+					if (client_fd < 0) {
+						break;
+					}
+					// replies are blocking writes; a stalled peer must not hold up the loop for long
+					timeval send_timeout{};
+					send_timeout.tv_sec = 1;
+					setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+					epoll_event client_event{};
+					client_event.events = EPOLLIN | EPOLLRDHUP;
+					client_event.data.fd = client_fd;
+					epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &client_event);
+					inbound[client_fd];
+				}
+				continue;
+			}
+			std::string &buffer = inbound[fd];
+			bool open = true;
+			char chunk[4096];
+			while (true) {
+				ssize_t got = recv(fd, chunk, sizeof(chunk), MSG_DONTWAIT);
+				if (got > 0) {
+					buffer.append(chunk, static_cast<size_t>(got));
+					continue;
+				}
+				if (got < 0 && (errno == EINTR)) {
+					continue;
+				}
+				open = got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+				break;
+			}
+			bool keep = true;
 			MessageType type;
 			std::string payload;
-			if (!recv_message(client_fd, type, payload)) {
-				close(client_fd);
-				return;
-			}
-				switch (type) {
-				case MessageType::STORAGE_REGISTER:
-					handle_storage_register(payload);
-					send_table(client_fd, snapshot_nodes(), replication_factor);
-					break;
-				case MessageType::CLIENT_HELLO:
-					log_line("INFO", "Client requested table");
-					send_table(client_fd, snapshot_nodes(), replication_factor);
-					break;
-				case MessageType::HEARTBEAT:
-					handle_heartbeat(payload);
-					send_message(client_fd, MessageType::HEARTBEAT_ACK, "ok");
-					break;
-				default:
-					log_line("WARN", "Unknown message type received");
-			}
-			close(client_fd);
-		}).detach();
-	}
-}
-
-// This records a storage registration.
+			FrameStatus status = FrameStatus::PARTIAL;
+			while (keep && (status = take_message(buffer, type, payload)) == FrameStatus::COMPLETE) {
+				keep = handle_message(fd, type, payload);
+			}
+			if (keep && status == FrameStatus::INVALID) {
+				// an oversized or corrupt frame leaves no way to find the next one
+				log_line("WARN", "dropping connection " + std::to_string(fd) + " after invalid frame");
+				open = false;
+			}
+			if (!keep) {
+				// the connection now belongs to the subscriber list
+				epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+				inbound.erase(fd);
+			} else if (!open) {
+				epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+				inbound.erase(fd);
+				close(fd);
+			}
+		}
+	}
+	close(epoll_fd);
+}
+
+// This answers one framed request. Returns false once the connection is handed off to the subscriber list.
+bool GTStoreManager::handle_message(int client_fd, MessageType type, const std::string &payload) {
+	switch (type) {
+	case MessageType::STORAGE_REGISTER: {
+		handle_storage_register(payload);
+		send_table(client_fd, current_table());
+		return true;
+	}
+	case MessageType::CLIENT_HELLO: {
+		log_line("INFO", "Client requested table");
+		send_table(client_fd, current_table());
+		return true;
+	}
+	case MessageType::TABLE_SYNC: {
+		EpochMessage request{0};
+		if (!decode_message<MessageType::TABLE_SYNC>(payload, request)) {
+			request.epoch = 0;
+		}
+		std::shared_ptr<const std::string> reply;
+		MessageType reply_type = build_sync_reply(request.epoch, reply);
+		send_message(client_fd, reply_type, *reply);
+		return true;
+	}
+	case MessageType::TABLE_SUBSCRIBE:
+		add_subscriber(client_fd);
+		return false;
+	case MessageType::HEARTBEAT:
+		send_typed<MessageType::HEARTBEAT_ACK>(client_fd, {handle_heartbeat(payload)});
+		return true;
+	case MessageType::DECOMMISSION: {
+		std::string reply = "bad request";
+		MessageType reply_type = MessageType::ERROR;
+		schema_t<MessageType::DECOMMISSION> request;
+		if (decode_message<MessageType::DECOMMISSION>(payload, request)) {
+			reply_type = handle_decommission(std::string(request.node_id), reply);
+		}
+		send_message(client_fd, reply_type, reply);
+		return true;
+	}
+	case MessageType::DRAIN_DONE: {
+		std::string reply = "bad request";
+		MessageType reply_type = MessageType::ERROR;
+		schema_t<MessageType::DRAIN_DONE> request;
+		if (decode_message<MessageType::DRAIN_DONE>(payload, request)) {
+			reply_type = handle_drain_done(std::string(request.node_id), reply);
+		}
+		send_message(client_fd, reply_type, reply);
+		return true;
+	}
+	default:
+		log_line("WARN", "Unknown message type received");
+		return true;
+	}
+}
+
+// This records a storage registration and gives it tokens in proportion to its capacity weight.
 void GTStoreManager::handle_storage_register(const std::string &payload) {
-	auto parts = gtstore_utils::split(payload, ',');
-	if (parts.size() != 3) {
+	RegisterRequest request;
+	if (!decode_message<MessageType::STORAGE_REGISTER>(payload, request) || request.node_id.empty()) {
 		log_line("WARN", "Invalid storage registration payload");
 		return;
 	}
-	StorageNodeInfo info;
-	info.node_id = parts[0];
-	info.address.host = parts[1];
-	info.address.port = static_cast<uint16_t>(std::stoi(parts[2]));
-	std::hash<std::string> hasher;
-	std::string token_seed = info.node_id + "-" + info.address.host + ":" + std::to_string(info.address.port);
-	info.token = static_cast<uint64_t>(hasher(token_seed));
+	std::string node_id(request.node_id);
+	NodeAddress address{std::string(request.host), request.port};
+	uint32_t weight = std::min(std::max<uint32_t>(request.weight, 1), static_cast<uint32_t>(MAX_NODE_WEIGHT));
+	std::vector<StorageNodeInfo> entries;
+	size_t token_count = static_cast<size_t>(weight) * tokens_per_weight;
+	bool changed = false;
 	{
 		std::lock_guard<std::mutex> guard(table_mutex);
-		auto existing = std::find_if(node_table.begin(), node_table.end(), [&](const StorageNodeInfo &node) {
-			return node.node_id == info.node_id;
-		});
-		if (existing != node_table.end()) {
-			*existing = info;
-		} else {
-			node_table.push_back(info);
+		std::vector<StorageNodeInfo> previous;
+		for (const auto &node : node_table) {
+			if (node.node_id == node_id) {
+				previous.push_back(node);
+			}
+		}
+		uint32_t bucket = previous.empty() ? free_jump_bucket() : previous.front().bucket;
+		for (size_t i = 0; i < token_count; ++i) {
+			entries.push_back(StorageNodeInfo{node_id, address, node_token(node_id, address, i), weight, bucket});
 		}
-		heartbeat_times[info.node_id] = std::chrono::steady_clock::now();
-		std::sort(node_table.begin(), node_table.end(), [](const StorageNodeInfo &lhs, const StorageNodeInfo &rhs) {
+		std::sort(entries.begin(), entries.end(), [](const StorageNodeInfo &lhs, const StorageNodeInfo &rhs) {
 			return lhs.token < rhs.token;
 		});
+		// node_table is token-sorted, so previous is too and can be compared entry by entry
+		changed = previous.size() != entries.size();
+		for (size_t i = 0; !changed && i < entries.size(); ++i) {
+			changed = previous[i].token != entries[i].token || previous[i].weight != entries[i].weight ||
+			          previous[i].address.host != entries[i].address.host || previous[i].address.port != entries[i].address.port;
+		}
+		if (changed) {
+			node_table.erase(std::remove_if(node_table.begin(), node_table.end(), [&](const StorageNodeInfo &node) {
+				return node.node_id == node_id;
+			}), node_table.end());
+			node_table.insert(node_table.end(), entries.begin(), entries.end());
+			std::sort(node_table.begin(), node_table.end(), [](const StorageNodeInfo &lhs, const StorageNodeInfo &rhs) {
+				return lhs.token < rhs.token;
+			});
+			record_table_change(entries, previous);
+		}
+		record_heartbeat(node_id, std::chrono::steady_clock::now());
+	}
+	log_line("INFO", "Registered storage " + node_id + " at " + address.host + ":" + std::to_string(address.port) +
+	         " weight=" + std::to_string(weight) + " tokens=" + std::to_string(token_count));
+	log_line("INFO", "Routing table snapshot: " + describe_nodes(current_table()->nodes));
+	if (changed) {
+		publish_table_epoch();
+	}
+}
+
+// This records a heartbeat from a table member: liveness, request load, hot keys and the peers its gossip group
+// declared dead. The ack is OK, DRAIN for a node being decommissioned, or REGISTER for a node missing from the
+// table (e.g. wrongly declared dead), whose beat is otherwise ignored.
+HeartbeatAction GTStoreManager::handle_heartbeat(const std::string &payload) {
+	auto now = std::chrono::steady_clock::now();
+	Heartbeat beat;
+	if (!decode_message<MessageType::HEARTBEAT>(payload, beat) || beat.node_id.empty()) {
+		log_line("WARN", "Malformed heartbeat of " + std::to_string(payload.size()) + " bytes");
+		return HeartbeatAction::OK;
+	}
+	std::string node_id(beat.node_id);
+	uint64_t load = beat.requests;
+	const std::vector<uint64_t> &reported = beat.hot_keys;
+	const std::vector<std::string_view> &gossip_dead = beat.dead;
+	bool hot_changed = false;
+	bool known = false;
+	bool draining = false;
+	size_t tracked = 0;
+	std::vector<std::string> dropped;
+	std::vector<StorageNodeInfo> removed_entries;
+	{
+		std::lock_guard<std::mutex> guard(table_mutex);
+		known = std::any_of(node_table.begin(), node_table.end(), [&](const StorageNodeInfo &node) {
+			return node.node_id == node_id;
+		});
+		// a node outside the table (dropped, or retired after a drain) only learns it must register again;
+		// tracking it here would give it a detector and deadline that later sweeps "remove" once more
+		if (!known) {
+			return HeartbeatAction::REGISTER;
+		}
+		record_heartbeat(node_id, now);
+		node_loads[node_id] = load;
+		for (uint64_t key_hash : reported) {
+			hot_changed = hot_key_times.find(key_hash) == hot_key_times.end() || hot_changed;
+			hot_key_times[key_hash] = now;
+		}
+		// one partitioned or lagging reporter must not evict a healthy peer on its own
+		for (const auto &dead_id : gossip_dead) {
+			std::string dead(dead_id);
+			if (!dead.empty() && dead != node_id && confirm_gossip_death(dead, node_id, now) && drop_node(dead, removed_entries)) {
+				dropped.push_back(dead);
+			}
+		}
+		if (hot_changed || !removed_entries.empty()) {
+			record_table_change({}, removed_entries);
+		}
+		tracked = hot_key_times.size();
+		draining = draining_nodes.count(node_id) != 0;
+	}
+	if (hot_changed) {
+		log_line("INFO", node_id + " reported hot keys, now tracking " + std::to_string(tracked));
 	}
-	log_line("INFO", "Registered storage " + info.node_id + " at " + info.address.host + ":" + std::to_string(info.address.port));
-	log_line("INFO", "Routing table snapshot: " + describe_nodes(snapshot_nodes()));
+	for (const auto &dead_id : dropped) {
+		log_line("WARN", "Removed storage " + dead_id + " declared dead by gossip (confirmed on report from " + node_id + ")");
+	}
+	if (hot_changed || !dropped.empty()) {
+		publish_table_epoch();
+	}
+	return draining ? HeartbeatAction::DRAIN : HeartbeatAction::OK;
 }
 
-// This records heartbeat timestamps.
-void GTStoreManager::handle_heartbeat(const std::string &payload) {
+// This starts a planned removal. A new epoch lists the node as draining, so placement moves its keys to the
+// nodes that will own them without it while reads can still fall back to it; its next heartbeat ack tells it
+// to copy its keys over.
+MessageType GTStoreManager::handle_decommission(const std::string &node_id, std::string &reply) {
+	{
+		std::lock_guard<std::mutex> guard(table_mutex);
+		bool known = false;
+		bool others = false;
+		for (const auto &node : node_table) {
+			known = known || node.node_id == node_id;
+			others = others || (node.node_id != node_id && draining_nodes.count(node.node_id) == 0);
+		}
+		if (!known) {
+			reply = "unknown node";
+			return MessageType::ERROR;
+		}
+		if (!others) {
+			reply = "last node";
+			return MessageType::ERROR;
+		}
+		reply = "draining";
+		if (!draining_nodes.insert(node_id).second) {
+			return MessageType::DECOMMISSION_ACK;
+		}
+		record_table_change({}, {});
+		// a restarted manager must still know the node is leaving, or its DRAIN_DONE would be refused
+		save_membership();
+	}
+	log_line("INFO", "Decommissioning " + node_id + ", placement moved off it while it drains");
+	publish_table_epoch();
+	return MessageType::DECOMMISSION_ACK;
+}
+
+// This removes a decommissioned node once it reports every key handed off.
+MessageType GTStoreManager::handle_drain_done(const std::string &node_id, std::string &reply) {
+	std::vector<StorageNodeInfo> removed_entries;
+	{
+		std::lock_guard<std::mutex> guard(table_mutex);
+		if (draining_nodes.count(node_id) == 0) {
+			reply = "not draining";
+			return MessageType::ERROR;
+		}
+		drop_node(node_id, removed_entries);
+		record_table_change({}, removed_entries);
+	}
+	log_line("INFO", "Removed decommissioned storage " + node_id + " after handoff");
+	log_line("INFO", "Routing table snapshot: " + describe_nodes(current_table()->nodes));
+	publish_table_epoch();
+	reply = "removed";
+	return MessageType::DECOMMISSION_ACK;
+}
+
+// This files a gossip death report and tells whether it is now confirmed: by reports from enough distinct
+// storage nodes within the TTL, or by the manager's own detector having gone quiet on the node. Caller holds table_mutex.
+bool GTStoreManager::confirm_gossip_death(const std::string &dead_id, const std::string &reporter, std::chrono::steady_clock::time_point now) {
+	auto detector = liveness.find(dead_id);
+	if (detector == liveness.end()) {
+		return false;
+	}
+	std::unordered_map<std::string, std::chrono::steady_clock::time_point> &reports = gossip_reports[dead_id];
+	reports[reporter] = now;
+	auto it = reports.begin();
+	while (it != reports.end()) {
+		if (now - it->second > GOSSIP_REPORT_TTL) {
+			it = reports.erase(it);
+		} else {
+			++it;
+		}
+	}
+	return reports.size() >= GOSSIP_DEAD_QUORUM || detector->second.phi(now) >= GOSSIP_CONFIRM_PHI;
+}
+
+// This removes every ring row of a node and its liveness state. Caller holds table_mutex.
+bool GTStoreManager::drop_node(const std::string &node_id, std::vector<StorageNodeInfo> &removed_entries) {
+	bool found = false;
+	auto it = node_table.begin();
+	while (it != node_table.end()) {
+		if (it->node_id == node_id) {
+			removed_entries.push_back(*it);
+			it = node_table.erase(it);
+			found = true;
+		} else {
+			++it;
+		}
+	}
+	liveness.erase(node_id);
+	liveness_deadlines->cancel(node_id);
+	draining_nodes.erase(node_id);
+	node_loads.erase(node_id);
+	gossip_reports.erase(node_id);
+	return found;
+}
+
+// This picks the jump bucket for a newly registering node: the lowest id no current member holds.
+// Members keep their id until they leave, so jump placement never renumbers a surviving node. Caller holds table_mutex.
+uint32_t GTStoreManager::free_jump_bucket() {
+	std::vector<bool> taken;
+	for (const auto &node : node_table) {
+		if (node.bucket >= taken.size()) {
+			taken.resize(node.bucket + 1, false);
+		}
+		taken[node.bucket] = true;
+	}
+	uint32_t bucket = 0;
+	while (bucket < taken.size() && taken[bucket]) {
+		++bucket;
+	}
+	return bucket;
+}
+
+// This feeds a heartbeat to the node's failure detector and moves its deadline. Caller holds table_mutex.
+void GTStoreManager::record_heartbeat(const std::string &node_id, std::chrono::steady_clock::time_point now) {
+	PhiAccrualDetector &detector = liveness.emplace(node_id, PhiAccrualDetector(HEARTBEAT_INTERVAL_SECONDS)).first->second;
+	detector.heartbeat(now);
+	liveness_deadlines->schedule(node_id, detector.deadline(phi_threshold_deviations));
+}
+
+// This lists tracked hot key hashes in ascending order. Caller holds table_mutex.
+std::vector<uint64_t> GTStoreManager::hot_key_list() {
+	std::vector<uint64_t> hot;
+	hot.reserve(hot_key_times.size());
+	for (const auto &entry : hot_key_times) {
+		hot.push_back(entry.first);
+	}
+	std::sort(hot.begin(), hot.end());
+	return hot;
+}
+
+// This lists load shares of capped nodes in node id order. Caller holds table_mutex.
+std::vector<NodeLoadShare> GTStoreManager::load_share_list() {
+	std::vector<NodeLoadShare> shares;
+	for (const auto &entry : keep_percent) {
+		shares.push_back(NodeLoadShare{entry.first, entry.second});
+	}
+	std::sort(shares.begin(), shares.end(), [](const NodeLoadShare &lhs, const NodeLoadShare &rhs) {
+		return lhs.node_id < rhs.node_id;
+	});
+	return shares;
+}
+
+// This lists the nodes being decommissioned in id order. Caller holds table_mutex.
+std::vector<std::string> GTStoreManager::draining_list() {
+	std::vector<std::string> draining(draining_nodes.begin(), draining_nodes.end());
+	std::sort(draining.begin(), draining.end());
+	return draining;
+}
+
+// This recomputes which nodes are over their load cap and how many keys they keep. Caller holds table_mutex.
+bool GTStoreManager::rebalance_load_shares() {
+	std::unordered_map<std::string, uint32_t> weights;
+	for (const auto &node : node_table) {
+		weights.emplace(node.node_id, std::max<uint32_t>(1, node.weight));
+	}
+	uint64_t total_load = 0;
+	double total_weight = 0.0;
+	for (const auto &entry : weights) {
+		auto load = node_loads.find(entry.first);
+		total_load += (load == node_loads.end()) ? 0 : load->second;
+		total_weight += entry.second;
+	}
+	std::unordered_map<std::string, uint32_t> next;
+	if (total_load >= MIN_BALANCED_LOAD && weights.size() > 1) {
+		double per_weight = static_cast<double>(total_load) / total_weight;
+		for (const auto &entry : weights) {
+			auto load = node_loads.find(entry.first);
+			if (load == node_loads.end()) {
+				continue;
+			}
+			// a capped node only sees its kept share, so scale back up to what it would get uncapped
+			auto current = keep_percent.find(entry.first);
+			uint32_t kept = (current == keep_percent.end()) ? 100 : current->second;
+			double demand = static_cast<double>(load->second) * 100.0 / kept;
+			double cap = load_factor * per_weight * entry.second;
+			// hysteresis: a capped node is released only well under its cap, and small corrections are skipped
+			if (demand <= cap && (kept == 100 || demand <= cap * LOAD_RELEASE_RATIO)) {
+				continue;
+			}
+			uint32_t share = std::max(MIN_KEEP_PERCENT, std::min<uint32_t>(99, static_cast<uint32_t>(cap * 100.0 / demand)));
+			if (kept < 100 && (share > kept ? share - kept : kept - share) < KEEP_STEP_PERCENT) {
+				share = kept;
+			}
+			next[entry.first] = share;
+		}
+	}
+	if (next == keep_percent) {
+		return false;
+	}
+	keep_percent.swap(next);
+	return true;
+}
+
+// This forgets hot keys nobody reported within the TTL. Caller holds table_mutex.
+bool GTStoreManager::expire_hot_keys(std::chrono::steady_clock::time_point now) {
+	bool changed = false;
+	auto it = hot_key_times.begin();
+	while (it != hot_key_times.end()) {
+		if (now - it->second > HOT_KEY_TTL) {
+			it = hot_key_times.erase(it);
+			changed = true;
+		} else {
+			++it;
+		}
+	}
+	return changed;
+}
+
+// This takes a reference to the latest published table without touching table_mutex.
+std::shared_ptr<const PublishedTable> GTStoreManager::current_table() {
+	return std::atomic_load(&published_table);
+}
+
+// This serializes the table and swaps in a new immutable version; readers holding the old one keep it
+// until they let go. Caller holds table_mutex, which only orders writers.
+void GTStoreManager::publish_table() {
+	TableSnapshot table;
+	table.nodes = node_table;
+	table.replication_factor = replication_factor;
+	table.epoch = table_epoch;
+	table.placement = placement_mode;
+	table.hot_keys = hot_key_list();
+	table.load_shares = load_share_list();
+	table.draining = draining_list();
+	std::shared_ptr<PublishedTable> next = std::make_shared<PublishedTable>();
+	next->epoch = table_epoch;
+	next->payload = build_table_payload(table);
+	next->nodes.swap(table.nodes);
+	std::atomic_store(&published_table, std::shared_ptr<const PublishedTable>(next));
+}
+
+// This bumps the epoch and remembers what changed. Caller holds table_mutex.
+void GTStoreManager::record_table_change(const std::vector<StorageNodeInfo> &added, const std::vector<StorageNodeInfo> &removed) {
+	TableDelta change;
+	change.base_epoch = table_epoch;
+	change.epoch = ++table_epoch;
+	change.replication_factor = replication_factor;
+	change.placement = placement_mode;
+	change.added = added;
+	change.removed = removed;
+	change.hot_keys = hot_key_list();
+	change.load_shares = load_share_list();
+	change.draining = draining_list();
+	table_history.push_back(change);
+	while (table_history.size() > MAX_TABLE_HISTORY) {
+		table_history.pop_front();
+	}
+	publish_table();
+	// only ring rows are persisted; other changes just need the saved epoch to stay ahead
+	if (!added.empty() || !removed.empty() || table_epoch >= persisted_epoch) {
+		save_membership();
+	}
+}
+
+// This writes the ring rows, the draining nodes and an epoch reserved ahead of the live one to the state file, durably
+// replacing the old file. Caller holds table_mutex.
+void GTStoreManager::save_membership() {
+	if (state_path.empty()) {
+		return;
+	}
+	TableSnapshot members{node_table, replication_factor, table_epoch + PERSISTED_EPOCH_RESERVE, placement_mode, {}, {}, draining_list()};
+	if (!write_file_durably(state_path, build_table_payload(members))) {
+		log_line("WARN", "Failed to persist membership to " + state_path + ": " + std::strerror(errno));
+		return;
+	}
+	persisted_epoch = members.epoch;
+}
+
+// This reloads the membership saved by a previous run so the table is routable before anyone
+// re-registers. Each loaded node starts a fresh detector; one that never heartbeats times out as usual.
+void GTStoreManager::load_membership() {
+	if (state_path.empty()) {
+		return;
+	}
+	std::ifstream in(state_path.c_str(), std::ios::binary);
+	std::string saved((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if (saved.empty()) {
+		return;
+	}
+	TableSnapshot members = parse_table_payload(saved);
 	std::lock_guard<std::mutex> guard(table_mutex);
-	heartbeat_times[payload] = std::chrono::steady_clock::now();
+	node_table = members.nodes;
+	draining_nodes.insert(members.draining.begin(), members.draining.end());
+	std::sort(node_table.begin(), node_table.end(), [](const StorageNodeInfo &lhs, const StorageNodeInfo &rhs) {
+		return lhs.token < rhs.token;
+	});
+	// one past the saved epoch, which the old run never reached, so no client keeps a table from it as current
+	table_epoch = members.epoch + 1;
+	publish_table();
+	auto now = std::chrono::steady_clock::now();
+	std::vector<std::string> node_ids;
+	for (const auto &node : node_table) {
+		if (!liveness.count(node.node_id)) {
+			node_ids.push_back(node.node_id);
+			record_heartbeat(node.node_id, now);
+		}
+	}
+	save_membership();
+	log_line("INFO", "Restored " + std::to_string(node_ids.size()) + " storage nodes (" + std::to_string(node_table.size()) +
+	         " ring entries) from " + state_path + " at epoch " + std::to_string(table_epoch) + ": " + join(node_ids, ','));
 }
 
-// This copies current node table.
-std::vector<StorageNodeInfo> GTStoreManager::snapshot_nodes() {
+// This answers "changes since epoch" with unchanged, a delta, or the full table.
+MessageType GTStoreManager::build_sync_reply(uint64_t since_epoch, std::shared_ptr<const std::string> &payload) {
+	// the common answers come from the published table and skip the lock
+	std::shared_ptr<const PublishedTable> table = current_table();
+	if (since_epoch == table->epoch) {
+		payload = std::make_shared<const std::string>(encode_message<MessageType::TABLE_UNCHANGED>({table->epoch}));
+		return MessageType::TABLE_UNCHANGED;
+	}
 	std::lock_guard<std::mutex> guard(table_mutex);
-	return node_table;
+	bool covered = since_epoch < table_epoch && !table_history.empty() && table_history.front().base_epoch <= since_epoch;
+	if (!covered) {
+		// share the published buffer rather than copying it
+		table = current_table();
+		payload = std::shared_ptr<const std::string>(table, &table->payload);
+		return MessageType::TABLE_PUSH;
+	}
+	// fold the per-epoch changes so an entry added and removed in the window cancels out
+	std::vector<StorageNodeInfo> added;
+	std::vector<StorageNodeInfo> removed;
+	for (const auto &change : table_history) {
+		if (change.epoch <= since_epoch) {
+			continue;
+		}
+		for (const auto &gone : change.removed) {
+			auto it = std::find_if(added.begin(), added.end(), [&](const StorageNodeInfo &node) {
+				return entry_key(node) == entry_key(gone);
+			});
+			if (it != added.end()) {
+				added.erase(it);
+			} else {
+				removed.push_back(gone);
+			}
+		}
+		for (const auto &node : change.added) {
+			added.push_back(node);
+		}
+	}
+	TableDelta delta;
+	delta.base_epoch = since_epoch;
+	delta.epoch = table_epoch;
+	delta.replication_factor = replication_factor;
+	delta.placement = placement_mode;
+	delta.added = added;
+	delta.removed = removed;
+	delta.hot_keys = hot_key_list();
+	delta.load_shares = load_share_list();
+	delta.draining = draining_list();
+	payload = std::make_shared<const std::string>(build_delta_payload(delta));
+	return MessageType::TABLE_DELTA;
+}
+
+// This hands a subscriber socket to the pusher thread, which greets it with the current epoch.
+void GTStoreManager::add_subscriber(int client_fd) {
+	// a stalled subscriber must not hold up the pusher for long
+	timeval send_timeout{};
+	send_timeout.tv_sec = 1;
+	setsockopt(client_fd, SOL_SOCKET, SO_SNDTIMEO, &send_timeout, sizeof(send_timeout));
+	{
+		std::lock_guard<std::mutex> guard(subscriber_mutex);
+		new_subscribers.push_back(client_fd);
+	}
+	subscriber_wakeup.notify_one();
+}
+
+// This asks the pusher thread to announce the current epoch. It never writes to a socket itself,
+// so the event loop and the liveness sweep are not held up by a slow subscriber.
+void GTStoreManager::publish_table_epoch() {
+	{
+		std::lock_guard<std::mutex> guard(subscriber_mutex);
+		push_pending = true;
+	}
+	subscriber_wakeup.notify_one();
+}
+
+// This sends epoch announcements with blocking writes and drops subscribers that fail. Epochs published
+// while a round is in flight fold into one announcement of the latest.
+void GTStoreManager::push_epochs() {
+	std::vector<int> subscribers;
+	while (running) {
+		std::vector<int> joined;
+		bool announce = false;
+		{
+			std::unique_lock<std::mutex> lock(subscriber_mutex);
+			subscriber_wakeup.wait(lock, [&]() { return push_pending || !new_subscribers.empty(); });
+			joined.swap(new_subscribers);
+			announce = push_pending;
+			push_pending = false;
+		}
+		uint64_t epoch = current_table()->epoch;
+		std::string payload = encode_message<MessageType::TABLE_EPOCH>({epoch});
+		if (announce) {
+			auto it = subscribers.begin();
+			while (it != subscribers.end()) {
+				if (send_message(*it, MessageType::TABLE_EPOCH, payload)) {
+					++it;
+				} else {
+					close(*it);
+					it = subscribers.erase(it);
+				}
+			}
+			log_line("INFO", "Published table epoch " + std::to_string(epoch) + " to " + std::to_string(subscribers.size()) + " subscribers");
+		}
+		for (int fd : joined) {
+			if (!send_message(fd, MessageType::TABLE_EPOCH, payload)) {
+				close(fd);
+				continue;
+			}
+			subscribers.push_back(fd);
+			log_line("INFO", "Table subscriber added (" + std::to_string(subscribers.size()) + " total)");
+		}
+	}
 }
 
-// This drops nodes that stopped sending heartbeats.
+// This drops nodes whose phi-accrual suspicion crossed the threshold.
 void GTStoreManager::monitor_heartbeats() {
-	const auto timeout = std::chrono::seconds(6);
+	int sweep = 0;
 	while (running) {
-		std::this_thread::sleep_for(std::chrono::seconds(2));
+		std::this_thread::sleep_for(LIVENESS_SWEEP);
+		bool maintenance = ++sweep % SWEEPS_PER_MAINTENANCE == 0;
 		auto now = std::chrono::steady_clock::now();
-		std::vector<std::pair<std::string, long long>> removed;
+		std::vector<std::string> removed;
+		std::vector<std::string> reasons;
+		std::vector<StorageNodeInfo> removed_entries;
+		bool hot_expired = false;
+		bool shares_changed = false;
+		std::string share_summary;
 		{
 			std::lock_guard<std::mutex> guard(table_mutex);
-			auto it = node_table.begin();
-			while (it != node_table.end()) {
-				auto hb = heartbeat_times.find(it->node_id);
-				bool expired = false;
-				if (hb != heartbeat_times.end()) {
-					if (now - hb->second > timeout) {
-						expired = true;
-					}
-				} else {
-					expired = true;
+			for (const auto &node_id : liveness_deadlines->advance(now)) {
+				auto detector = liveness.find(node_id);
+				if (detector == liveness.end()) {
+					continue;
 				}
-				if (expired) {
-					long long seconds_since = -1;
-					if (hb != heartbeat_times.end()) {
-						seconds_since = std::chrono::duration_cast<std::chrono::seconds>(now - hb->second).count();
-					}
-					removed.emplace_back(it->node_id, seconds_since);
-					heartbeat_times.erase(it->node_id);
-					it = node_table.erase(it);
-				} else {
-					++it;
+				double phi = detector->second.phi(now);
+				if (phi < phi_threshold) {
+					// rounding put us a hair early; check again at the next tick
+					liveness_deadlines->schedule(node_id, now + LIVENESS_SWEEP);
+					continue;
 				}
+				std::ostringstream reason;
+				reason.precision(2);
+				reason << std::fixed << "at phi=" << phi << " after " << detector->second.silence(now) << "s without heartbeat";
+				removed.push_back(node_id);
+				reasons.push_back(reason.str());
 			}
-		}
-		for (const auto &entry : removed) {
-			std::string msg = "Removed dead storage " + entry.first;
-			if (entry.second >= 0) {
-				msg += " after " + std::to_string(entry.second) + "s without heartbeat";
+			for (const auto &node_id : removed) {
+				drop_node(node_id, removed_entries);
 			}
-			log_line("WARN", msg);
+			hot_expired = maintenance && expire_hot_keys(now);
+			if (maintenance && placement_mode == PlacementMode::BOUNDED) {
+				shares_changed = rebalance_load_shares();
+				for (const auto &share : load_share_list()) {
+					share_summary += " " + share.node_id + "=" + std::to_string(share.keep_percent) + "%";
+				}
+			}
+			if (!removed_entries.empty() || hot_expired || shares_changed) {
+				record_table_change({}, removed_entries);
+			}
+		}
+		for (size_t i = 0; i < removed.size(); ++i) {
+			log_line("WARN", "Removed dead storage " + removed[i] + " " + reasons[i]);
 		}
 		if (!removed.empty()) {
-			log_line("INFO", "Routing table snapshot: " + describe_nodes(snapshot_nodes()));
+			log_line("INFO", "Routing table snapshot: " + describe_nodes(current_table()->nodes));
+		}
+		if (shares_changed) {
+			log_line("INFO", "Load caps now:" + (share_summary.empty() ? std::string(" none") : share_summary));
+		}
+		if (!removed.empty() || hot_expired || shares_changed) {
+			publish_table_epoch();
 		}
 	}
 }
@@ -0,0 +1,408 @@
+#ifndef GTSTORE_MESSAGES_HPP
+#define GTSTORE_MESSAGES_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "codec.hpp"
+#include "net_common.hpp"
+
+// NEWLY ADDED: typed message schema.
+// Each structured MessageType maps to a struct through MessageSchema. The
+// struct lists its members once in fields(), and the templates below derive
+// its encoder and decoder at compile time.
+//
+// Wire layout of a struct:
+// - every fixed-width integer or enum field first, little-endian, at offsets
+//   known at compile time;
+// - then the variable fields in declaration order: strings as a varint length
+//   plus bytes, vectors as a varint count plus elements, nested structs inline.
+//
+// The decoder checks the fixed prefix length once and then reads those fields
+// without further branches. String fields may be std::string_view: decoding
+// points them into the payload, so they live only as long as it does.
+// Messages whose payload is opaque bytes (GET_OK, STREAM_CHUNK, table pushes
+// and deltas, status text) keep using send_message directly.
+
+// NEWLY ADDED: heartbeat reply telling a storage node what to do next
+enum class HeartbeatAction : uint8_t {
+    OK = 0,
+    DRAIN = 1,
+    REGISTER = 2,
+};
+
+// NEWLY ADDED: largest valid value of each enum carried in a message; decoding rejects anything above it
+template <typename Enum>
+struct schema_max;
+
+template <> struct schema_max<HeartbeatAction> { static constexpr HeartbeatAction value = HeartbeatAction::REGISTER; };
+
+// NEWLY ADDED: key plus encoded value for CLIENT_PUT and REPL_PUT
+struct PutRequest {
+    std::string_view key;
+    std::string_view value;
+
+    template <typename Self>
+    static auto fields(Self &self) { return std::tie(self.key, self.value); }
+};
+
+// NEWLY ADDED: a bare key for CLIENT_GET and the stream requests
+struct KeyRequest {
+    std::string_view key;
+
+    template <typename Self>
+    static auto fields(Self &self) { return std::tie(self.key); }
+};
+
+// NEWLY ADDED: a storage node id for DECOMMISSION and DRAIN_DONE
+struct NodeRequest {
+    std::string_view node_id;
+
+    template <typename Self>
+    static auto fields(Self &self) { return std::tie(self.node_id); }
+};
+
+// NEWLY ADDED: a table epoch (sync request, unchanged reply, subscription push, misroute reply)
+struct EpochMessage {
+    uint64_t epoch;
+
+    template <typename Self>
+    static auto fields(Self &self) { return std::tie(self.epoch); }
+};
+
+// NEWLY ADDED: a storage node announcing itself to the manager
+struct RegisterRequest {
+    uint16_t port;
+    uint32_t weight;
+    std::string_view node_id;
+    std::string_view host;
+
+    template <typename Self>
+    static auto fields(Self &self) { return std::tie(self.port, self.weight, self.node_id, self.host); }
+};
+
+// NEWLY ADDED: one storage heartbeat: request count for the window, hot key hashes, peers gossip declared dead
+struct Heartbeat {
+    uint64_t requests;
+    std::string_view node_id;
+    std::vector<uint64_t> hot_keys;
+    std::vector<std::string_view> dead;
+
+    template <typename Self>
+    static auto fields(Self &self) { return std::tie(self.requests, self.node_id, self.hot_keys, self.dead); }
+};
+
+// NEWLY ADDED: the manager's answer to a heartbeat
+struct HeartbeatAck {
+    HeartbeatAction action;
+
+    template <typename Self>
+    static auto fields(Self &self) { return std::tie(self.action); }
+};
+
+// NEWLY ADDED: closing record of a streamed value, sent after the last STREAM_CHUNK and kept by storage
+struct StreamManifest {
+    uint64_t chunk_count;
+    uint64_t total_bytes;
+    uint32_t checksum;
+
+    template <typename Self>
+    static auto fields(Self &self) { return std::tie(self.chunk_count, self.total_bytes, self.checksum); }
+};
+
+// NEWLY ADDED: MessageType to payload struct mapping; types without a specialization are opaque
+template <MessageType Type>
+struct MessageSchema;
+
+template <> struct MessageSchema<MessageType::CLIENT_PUT> { using type = PutRequest; };
+template <> struct MessageSchema<MessageType::REPL_PUT> { using type = PutRequest; };
+template <> struct MessageSchema<MessageType::CLIENT_GET> { using type = KeyRequest; };
+template <> struct MessageSchema<MessageType::STREAM_PUT> { using type = KeyRequest; };
+template <> struct MessageSchema<MessageType::STREAM_REPL_PUT> { using type = KeyRequest; };
+template <> struct MessageSchema<MessageType::STREAM_GET> { using type = KeyRequest; };
+template <> struct MessageSchema<MessageType::STREAM_END> { using type = StreamManifest; };
+template <> struct MessageSchema<MessageType::STORAGE_REGISTER> { using type = RegisterRequest; };
+template <> struct MessageSchema<MessageType::HEARTBEAT> { using type = Heartbeat; };
+template <> struct MessageSchema<MessageType::HEARTBEAT_ACK> { using type = HeartbeatAck; };
+template <> struct MessageSchema<MessageType::TABLE_SYNC> { using type = EpochMessage; };
+template <> struct MessageSchema<MessageType::TABLE_UNCHANGED> { using type = EpochMessage; };
+template <> struct MessageSchema<MessageType::TABLE_EPOCH> { using type = EpochMessage; };
+template <> struct MessageSchema<MessageType::WRONG_OWNER> { using type = EpochMessage; };
+template <> struct MessageSchema<MessageType::DECOMMISSION> { using type = NodeRequest; };
+template <> struct MessageSchema<MessageType::DRAIN_DONE> { using type = NodeRequest; };
+
+template <MessageType Type>
+using schema_t = typename MessageSchema<Type>::type;
+
+namespace wire_detail {
+
+template <typename T>
+using bare_t = std::remove_cv_t<std::remove_reference_t<T>>;
+
+// bool is left out so a corrupt byte can never be loaded into one
+template <typename T>
+constexpr bool is_fixed_v = (std::is_integral<T>::value && !std::is_same<T, bool>::value) || std::is_enum<T>::value;
+
+template <typename T, typename = void>
+struct has_fields : std::false_type {};
+
+template <typename T>
+struct has_fields<T, std::void_t<decltype(T::fields(std::declval<T &>()))>> : std::true_type {};
+
+template <typename T>
+struct is_vector : std::false_type {};
+
+template <typename T>
+struct is_vector<std::vector<T>> : std::true_type {};
+
+template <size_t Width>
+struct UintOfWidth;
+template <> struct UintOfWidth<1> { using type = uint8_t; };
+template <> struct UintOfWidth<2> { using type = uint16_t; };
+template <> struct UintOfWidth<4> { using type = uint32_t; };
+template <> struct UintOfWidth<8> { using type = uint64_t; };
+
+template <typename T>
+constexpr size_t fixed_width() {
+    if constexpr (is_fixed_v<T>) {
+        return sizeof(T);
+    } else {
+        return 0;
+    }
+}
+
+template <typename Tuple>
+struct FixedBytes;
+
+template <typename... Fields>
+struct FixedBytes<std::tuple<Fields...>> {
+    static constexpr size_t value = (fixed_width<bare_t<Fields>>() + ... + 0);
+};
+
+// size of the fixed-width prefix of a message struct
+template <typename Msg>
+constexpr size_t fixed_bytes_v = FixedBytes<decltype(Msg::fields(std::declval<Msg &>()))>::value;
+
+// This writes a fixed-width value little-endian.
+template <typename T>
+void store_fixed(char *out, T value) {
+    typename UintOfWidth<sizeof(T)>::type bits;
+    std::memcpy(&bits, &value, sizeof(T));
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        out[i] = static_cast<char>(static_cast<uint64_t>(bits) >> (8 * i));
+    }
+}
+
+// This reads a little-endian fixed-width value.
+template <typename T>
+T load_fixed(const char *in) {
+    typename UintOfWidth<sizeof(T)>::type bits = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        bits |= static_cast<decltype(bits)>(static_cast<uint64_t>(static_cast<uint8_t>(in[i])) << (8 * i));
+    }
+    T value;
+    std::memcpy(&value, &bits, sizeof(T));
+    return value;
+}
+
+// This tells whether a loaded fixed value is valid: integers always are, enums must not pass schema_max.
+template <typename T>
+bool fixed_in_range(T value) {
+    if constexpr (std::is_enum<T>::value) {
+        using Raw = std::underlying_type_t<T>;
+        return static_cast<Raw>(value) <= static_cast<Raw>(schema_max<T>::value);
+    } else {
+        (void)value;
+        return true;
+    }
+}
+
+// smallest number of bytes one element can take, so a count can be checked before allocating
+template <typename T>
+constexpr size_t min_element_bytes() {
+    if constexpr (is_fixed_v<T>) {
+        return sizeof(T);
+    } else if constexpr (has_fields<T>::value) {
+        return fixed_bytes_v<T> > 0 ? fixed_bytes_v<T> : 1;
+    } else {
+        return 1;
+    }
+}
+
+template <typename Msg>
+size_t encoded_size(const Msg &message);
+template <typename Msg>
+void append_fields(std::string &out, const Msg &message);
+template <typename Msg>
+bool read_fields(std::string_view in, size_t &pos, Msg &message);
+
+// This bounds the bytes one variable field takes, for a single reserve.
+template <typename T>
+size_t variable_size(const T &field) {
+    if constexpr (is_fixed_v<T>) {
+        return 0;
+    } else if constexpr (has_fields<T>::value) {
+        return encoded_size(field);
+    } else if constexpr (is_vector<T>::value) {
+        size_t total = 10;
+        for (const auto &item : field) {
+            if constexpr (is_fixed_v<bare_t<decltype(item)>>) {
+                total += sizeof(item);
+            } else {
+                total += variable_size(item);
+            }
+        }
+        return total;
+    } else {
+        return 10 + field.size();
+    }
+}
+
+// This appends one variable field; fixed fields were already written with the prefix.
+template <typename T>
+void append_variable(std::string &out, const T &field) {
+    if constexpr (is_fixed_v<T>) {
+        return;
+    } else if constexpr (has_fields<T>::value) {
+        append_fields(out, field);
+    } else if constexpr (is_vector<T>::value) {
+        put_varint(out, field.size());
+        for (const auto &item : field) {
+            using Item = bare_t<decltype(item)>;
+            if constexpr (is_fixed_v<Item>) {
+                char bytes[sizeof(Item)];
+                store_fixed(bytes, item);
+                out.append(bytes, sizeof(Item));
+            } else {
+                append_variable(out, item);
+            }
+        }
+    } else {
+        put_varint(out, field.size());
+        out.append(field.data(), field.size());
+    }
+}
+
+// This reads one variable field.
+template <typename T>
+bool read_variable(std::string_view in, size_t &pos, T &field) {
+    if constexpr (is_fixed_v<T>) {
+        return true;
+    } else if constexpr (has_fields<T>::value) {
+        return read_fields(in, pos, field);
+    } else if constexpr (is_vector<T>::value) {
+        using Item = typename T::value_type;
+        uint64_t count = 0;
+        if (!get_varint(in, pos, count) || count > (in.size() - pos) / min_element_bytes<Item>()) {
+            return false;
+        }
+        field.resize(static_cast<size_t>(count));
+        for (auto &item : field) {
+            if constexpr (is_fixed_v<Item>) {
+                item = load_fixed<Item>(in.data() + pos);
+                pos += sizeof(Item);
+                if (!fixed_in_range(item)) {
+                    return false;
+                }
+            } else if (!read_variable(in, pos, item)) {
+                return false;
+            }
+        }
+        return true;
+    } else {
+        uint64_t length = 0;
+        if (!get_varint(in, pos, length) || length > in.size() - pos) {
+            return false;
+        }
+        field = T(in.data() + pos, static_cast<size_t>(length));
+        pos += static_cast<size_t>(length);
+        return true;
+    }
+}
+
+// This bounds the encoded size of a message struct.
+template <typename Msg>
+size_t encoded_size(const Msg &message) {
+    return std::apply([](const auto &...field) { return (fixed_bytes_v<Msg> + ... + variable_size(field)); }, Msg::fields(message));
+}
+
+// This appends a message struct: the fixed prefix in one resize, then the variable fields.
+template <typename Msg>
+void append_fields(std::string &out, const Msg &message) {
+    auto fields = Msg::fields(message);
+    size_t offset = out.size();
+    out.resize(offset + fixed_bytes_v<Msg>);
+    std::apply([&](const auto &...field) {
+        ([&] {
+            using Field = bare_t<decltype(field)>;
+            if constexpr (is_fixed_v<Field>) {
+                store_fixed(&out[offset], field);
+                offset += sizeof(Field);
+            }
+        }(), ...);
+    }, fields);
+    std::apply([&](const auto &...field) { (append_variable(out, field), ...); }, fields);
+}
+
+// This reads a message struct: one length check for the fixed prefix, then the variable fields.
+template <typename Msg>
+bool read_fields(std::string_view in, size_t &pos, Msg &message) {
+    if (in.size() - pos < fixed_bytes_v<Msg>) {
+        return false;
+    }
+    auto fields = Msg::fields(message);
+    const char *cursor = in.data() + pos;
+    bool ok = true;
+    std::apply([&](auto &...field) {
+        ([&] {
+            using Field = bare_t<decltype(field)>;
+            if constexpr (is_fixed_v<Field>) {
+                field = load_fixed<Field>(cursor);
+                cursor += sizeof(Field);
+                ok = ok && fixed_in_range(field);
+            }
+        }(), ...);
+    }, fields);
+    pos += fixed_bytes_v<Msg>;
+    std::apply([&](auto &...field) { ((ok = ok && read_variable(in, pos, field)), ...); }, fields);
+    return ok;
+}
+
+}
+
+// This appends the payload of a typed message to a caller-owned buffer.
+template <MessageType Type>
+void encode_message(const schema_t<Type> &message, std::string &out) {
+    out.reserve(out.size() + wire_detail::encoded_size(message));
+    wire_detail::append_fields(out, message);
+}
+
+// This builds the payload of a typed message.
+template <MessageType Type>
+std::string encode_message(const schema_t<Type> &message) {
+    std::string out;
+    encode_message<Type>(message, out);
+    return out;
+}
+
+// This decodes a whole payload into the type's struct; false when it is short, malformed, carries an
+// out-of-range enum or has bytes left over.
+template <MessageType Type>
+bool decode_message(std::string_view payload, schema_t<Type> &message) {
+    size_t pos = 0;
+    return wire_detail::read_fields(payload, pos, message) && pos == payload.size();
+}
+
+// This encodes and sends a typed message.
+template <MessageType Type>
+bool send_typed(int fd, const schema_t<Type> &message, uint16_t flags = 0) {
+    return send_message(fd, Type, encode_message<Type>(message), flags);
+}
+
+#endif
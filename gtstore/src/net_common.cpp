@@ -1,15 +1,77 @@
 #include "net_common.hpp"
 
 #include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <sys/uio.h>
 
-// This sends every byte using blocking retries.
+#include "crc32c.hpp"
+
+namespace {
+const size_t CHECKSUM_BYTES = 4;
+
+// This computes the frame checksum over the header bytes and the payload.
+uint32_t frame_checksum(const MessageHeader &header, const char *payload, size_t length) {
+    uint32_t crc = crc32c(&header, sizeof(header));
+    return crc32c_extend(crc, payload, length);
+}
+
+// This compares a received big-endian trailer with the checksum of the frame.
+bool checksum_matches(const MessageHeader &header, const char *payload, size_t length, const char *trailer) {
+    uint32_t wire = 0;
+    std::memcpy(&wire, trailer, CHECKSUM_BYTES);
+    return ntohl(wire) == frame_checksum(header, payload, length);
+}
+
+// This gathers the pieces in one sendmsg per pass, stepping past whatever a partial write took.
+// MSG_NOSIGNAL turns a closed peer into a false return rather than SIGPIPE.
+bool send_all_vectored(int fd, iovec *pieces, size_t count) {
+    while (count > 0) {
+        msghdr message{};
+        message.msg_iov = pieces;
+        message.msg_iovlen = count;
+        ssize_t sent = sendmsg(fd, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "send failed: " << std::strerror(errno) << "\n";
+            return false;
+        }
+        if (sent == 0) {
+            return false;
+        }
+        size_t left = static_cast<size_t>(sent);
+        while (count > 0 && left >= pieces->iov_len) {
+            left -= pieces->iov_len;
+            ++pieces;
+            --count;
+        }
+        if (count > 0) {
+            pieces->iov_base = static_cast<char *>(pieces->iov_base) + left;
+            pieces->iov_len -= left;
+        }
+    }
+    return true;
+}
+}
+
+// This reads GTSTORE_CHECKSUM once; checksums are on unless it is "0".
+bool frame_checksums_enabled() {
+    static const bool enabled = [] {
+        const char *value = std::getenv("GTSTORE_CHECKSUM");
+        return value == nullptr || std::string(value) != "0";
+    }();
+    return enabled;
+}
+
+// This sends every byte using blocking retries. A closed peer yields false rather than SIGPIPE.
 bool send_all(int fd, const void *data, size_t length) {
     const uint8_t *buffer = static_cast<const uint8_t *>(data);
     size_t sent_total = 0;
     while (sent_total < length) {
-        ssize_t sent = send(fd, buffer + sent_total, length - sent_total, 0);
+        ssize_t sent = send(fd, buffer + sent_total, length - sent_total, MSG_NOSIGNAL);
         if (sent < 0) {
             if (errno == EINTR) {
                 continue;
@@ -48,44 +110,113 @@ bool recv_all(int fd, void *data, size_t length) {
 
 // This sends a header followed by payload.
 bool send_message(int fd, MessageType type, const std::string &payload) {
+    return send_message(fd, type, payload, 0);
+}
+
+// This sends a typed message with payload and header flags as one frame, adding the checksum trailer when enabled.
+bool send_message(int fd, MessageType type, const std::string &payload, uint16_t flags) {
+    if (payload.size() > MAX_FRAME_BYTES) {
+        std::cerr << "send refused: payload of " << payload.size() << " bytes exceeds frame limit\n";
+        return false;
+    }
+    flags &= static_cast<uint16_t>(~MESSAGE_FLAG_CHECKSUM);
+    bool checksum = frame_checksums_enabled();
+    if (checksum) {
+        flags |= MESSAGE_FLAG_CHECKSUM;
+    }
+
     MessageHeader header{};
     header.type = htons(static_cast<uint16_t>(type));
-    header.reserved = 0;
+    header.flags = htons(flags);
     header.payload_size = htonl(static_cast<uint32_t>(payload.size()));
 
-    if (!send_all(fd, &header, sizeof(header))) {
-        return false;
-    }
+    // header, payload and trailer go out in one gathered write without copying the payload
+    uint32_t wire = checksum ? htonl(frame_checksum(header, payload.data(), payload.size())) : 0;
+    iovec pieces[3];
+    size_t count = 0;
+    pieces[count++] = {&header, sizeof(header)};
     if (!payload.empty()) {
-        return send_all(fd, payload.data(), payload.size());
+        pieces[count++] = {const_cast<char *>(payload.data()), payload.size()};
     }
-    return true;
+    if (checksum) {
+        pieces[count++] = {&wire, CHECKSUM_BYTES};
+    }
+    return send_all_vectored(fd, pieces, count);
 }
 
 // This receives a header and payload.
 bool recv_message(int fd, MessageType &type, std::string &payload) {
+    uint16_t flags = 0;
+    return recv_message(fd, type, payload, flags);
+}
+
+// This reads a typed message with payload and header flags, rejecting oversized or corrupt frames.
+bool recv_message(int fd, MessageType &type, std::string &payload, uint16_t &flags) {
     MessageHeader header{};
+    payload.clear();
     if (!recv_all(fd, &header, sizeof(header))) {
         return false;
     }
 
     uint16_t raw_type = ntohs(header.type);
+    uint16_t raw_flags = ntohs(header.flags);
     uint32_t payload_len = ntohl(header.payload_size);
+    if (payload_len > MAX_FRAME_BYTES) {
+        // checked before allocating so a garbled length cannot exhaust memory
+        std::cerr << "recv refused: frame announces " << payload_len << " bytes\n";
+        return false;
+    }
     type = static_cast<MessageType>(raw_type);
+    flags = static_cast<uint16_t>(raw_flags & ~MESSAGE_FLAG_CHECKSUM);
 
-    payload.clear();
-    if (payload_len == 0) {
-        return true;
+    if (payload_len > 0) {
+        payload.resize(payload_len);
+        if (!recv_all(fd, &payload[0], payload.size())) {
+            payload.clear();
+            return false;
+        }
     }
-
-    payload.resize(payload_len);
-    if (!recv_all(fd, &payload[0], payload.size())) {
-        payload.clear();
-        return false;
+    if (raw_flags & MESSAGE_FLAG_CHECKSUM) {
+        char trailer[CHECKSUM_BYTES];
+        if (!recv_all(fd, trailer, sizeof(trailer))) {
+            payload.clear();
+            return false;
+        }
+        if (!checksum_matches(header, payload.data(), payload.size(), trailer)) {
+            std::cerr << "recv refused: frame checksum mismatch\n";
+            payload.clear();
+            return false;
+        }
     }
     return true;
 }
 
+// This pops one complete header, payload and optional trailer off the front of a receive buffer.
+FrameStatus take_message(std::string &buffer, MessageType &type, std::string &payload) {
+    if (buffer.size() < sizeof(MessageHeader)) {
+        return FrameStatus::PARTIAL;
+    }
+    MessageHeader header{};
+    std::memcpy(&header, buffer.data(), sizeof(header));
+    uint32_t payload_len = ntohl(header.payload_size);
+    if (payload_len > MAX_FRAME_BYTES) {
+        return FrameStatus::INVALID;
+    }
+    bool checksum = (ntohs(header.flags) & MESSAGE_FLAG_CHECKSUM) != 0;
+    size_t frame_len = sizeof(header) + payload_len + (checksum ? CHECKSUM_BYTES : 0);
+    if (buffer.size() < frame_len) {
+        return FrameStatus::PARTIAL;
+    }
+    const char *body = buffer.data() + sizeof(header);
+    if (checksum && !checksum_matches(header, body, payload_len, body + payload_len)) {
+        return FrameStatus::INVALID;
+    }
+    type = static_cast<MessageType>(ntohs(header.type));
+    payload.assign(body, payload_len);
+    buffer.erase(0, frame_len);
+    return FrameStatus::COMPLETE;
+}
+
 // This opens a blocking client socket.
 int connect_to_host(const NodeAddress &address) {
     int fd = socket(AF_INET, SOCK_STREAM, 0);
@@ -7,6 +7,7 @@
 #include <netinet/in.h>
 #include <string>
 #include <sys/socket.h>
+#include <vector>
 #include <unistd.h>
 
 // NEWLY ADDED: shared message type ids
@@ -22,16 +23,58 @@ enum class MessageType : uint16_t {
     HEARTBEAT_ACK = 9,
     TABLE_PUSH = 10,
     STORAGE_REGISTER = 11,
-    CLIENT_HELLO = 12
+    CLIENT_HELLO = 12,
+    TABLE_SYNC = 13,
+    TABLE_DELTA = 14,
+    TABLE_UNCHANGED = 15,
+    TABLE_SUBSCRIBE = 16,
+    TABLE_EPOCH = 17,
+    WRONG_OWNER = 18,
+    DECOMMISSION = 19,
+    DECOMMISSION_ACK = 20,
+    DRAIN_DONE = 21,
+    STREAM_PUT = 22,
+    STREAM_REPL_PUT = 23,
+    STREAM_READY = 24,
+    STREAM_CHUNK = 25,
+    STREAM_END = 26,
+    STREAM_GET = 27,
+    STREAMED_VALUE = 28
 };
 
 // NEWLY ADDED: compact header carried before each payload
 struct MessageHeader {
     uint16_t type;
-    uint16_t reserved;
+    uint16_t flags;
     uint32_t payload_size;
 };
 
+// NEWLY ADDED: MessageHeader flag bits
+// the value inside a put, get reply or handoff is one lz block (see lz.hpp)
+const uint16_t MESSAGE_FLAG_COMPRESSED = 0x0001;
+// a 4-byte CRC32C over header and payload follows the payload (see crc32c.hpp)
+const uint16_t MESSAGE_FLAG_CHECKSUM = 0x0002;
+// a handoff only fills a key the receiver lacks, so it cannot undo a newer client write
+const uint16_t MESSAGE_FLAG_KEEP_EXISTING = 0x0004;
+
+// largest payload a peer may announce; bigger headers are treated as corrupt
+const uint32_t MAX_FRAME_BYTES = 8u * 1024u * 1024u;
+
+// streamed values travel as STREAM_CHUNK frames of at most this many bytes
+const uint32_t STREAM_CHUNK_BYTES = 64u * 1024u;
+// largest value a streamed put may carry
+const uint64_t MAX_STREAM_VALUE_BYTES = 64ull * 1024ull * 1024ull;
+
+// jump placement bucket ids stay below this; a table naming a higher one is rejected
+const uint32_t MAX_JUMP_BUCKETS = 1u << 16;
+
+// NEWLY ADDED: outcome of pulling a frame off a receive buffer
+enum class FrameStatus : uint8_t {
+    COMPLETE = 0,
+    PARTIAL = 1,
+    INVALID = 2,
+};
+
 // NEWLY ADDED: describes a TCP endpoint
 struct NodeAddress {
     std::string host;
@@ -43,6 +86,49 @@ struct StorageNodeInfo {
     std::string node_id;
     NodeAddress address;
     uint64_t token;
+    uint32_t weight;
+    // jump placement bucket; the manager keeps it for the node's lifetime in the table
+    uint32_t bucket;
+};
+
+// NEWLY ADDED: how keys are mapped onto storage nodes
+enum class PlacementMode : uint8_t {
+    RING = 0,
+    RENDEZVOUS = 1,
+    JUMP = 2,
+    BOUNDED = 3
+};
+
+// NEWLY ADDED: share of its keys a node over its load cap keeps, in percent
+struct NodeLoadShare {
+    std::string node_id;
+    uint32_t keep_percent;
+};
+
+// NEWLY ADDED: routing table as served by the manager
+struct TableSnapshot {
+    std::vector<StorageNodeInfo> nodes;
+    size_t replication_factor;
+    uint64_t epoch;
+    PlacementMode placement;
+    std::vector<uint64_t> hot_keys;
+    std::vector<NodeLoadShare> load_shares;
+    // nodes being decommissioned: placement leaves them out, reads still fall back to them
+    std::vector<std::string> draining;
+};
+
+// NEWLY ADDED: ring entries added and removed between two table epochs
+struct TableDelta {
+    uint64_t base_epoch;
+    uint64_t epoch;
+    size_t replication_factor;
+    PlacementMode placement;
+    std::vector<StorageNodeInfo> added;
+    std::vector<StorageNodeInfo> removed;
+    std::vector<uint64_t> hot_keys;
+    std::vector<NodeLoadShare> load_shares;
+    // the whole draining list, like the hot keys and shares
+    std::vector<std::string> draining;
 };
 
 // This sends every byte in the given buffer.
@@ -54,9 +140,21 @@ bool recv_all(int fd, void *data, size_t length);
 // This sends a typed message with payload.
 bool send_message(int fd, MessageType type, const std::string &payload);
 
+// This sends a typed message with payload and header flags.
+bool send_message(int fd, MessageType type, const std::string &payload, uint16_t flags);
+
 // This reads a typed message with payload.
 bool recv_message(int fd, MessageType &type, std::string &payload);
 
+// This reads a typed message with payload and header flags.
+bool recv_message(int fd, MessageType &type, std::string &payload, uint16_t &flags);
+
+// This pops one complete message off the front of a receive buffer. INVALID means the stream is corrupt.
+FrameStatus take_message(std::string &buffer, MessageType &type, std::string &payload);
+
+// This reports whether outgoing frames carry a checksum (GTSTORE_CHECKSUM=0 turns it off).
+bool frame_checksums_enabled();
+
 // This opens a client socket to host:port.
 int connect_to_host(const NodeAddress &address);
 
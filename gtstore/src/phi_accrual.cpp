@@ -0,0 +1,104 @@
+#include "phi_accrual.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+const size_t MAX_SAMPLES = 100;
+// floors the spread so a perfectly regular sender does not become infinitely touchy
+const double MIN_STD_DEVIATION = 0.5;
+
+// This is phi for a silence y standard deviations past the mean (logistic approximation of the normal tail).
+double phi_at(double y) {
+    double e = std::exp(-y * (1.5976 + 0.070566 * y * y));
+    if (y > 0) {
+        return -std::log10(e / (1.0 + e));
+    }
+    return -std::log10(1.0 - 1.0 / (1.0 + e));
+}
+}
+
+// This seeds the window with the expected interval until real samples arrive.
+PhiAccrualDetector::PhiAccrualDetector(double expected_interval_seconds)
+    : expected_interval(std::max(0.001, expected_interval_seconds)) {
+}
+
+// This records a heartbeat arrival.
+void PhiAccrualDetector::heartbeat(std::chrono::steady_clock::time_point now) {
+    if (!has_arrival) {
+        // bootstrap with two samples around the expected interval, as Akka does
+        double spread = expected_interval / 4.0;
+        add_interval(expected_interval - spread);
+        add_interval(expected_interval + spread);
+        has_arrival = true;
+    } else {
+        add_interval(std::chrono::duration_cast<std::chrono::duration<double>>(now - last_arrival).count());
+    }
+    last_arrival = now;
+}
+
+// This keeps a sliding window of intervals with running sums.
+void PhiAccrualDetector::add_interval(double seconds) {
+    intervals.push_back(seconds);
+    sum += seconds;
+    sum_squares += seconds * seconds;
+    if (intervals.size() > MAX_SAMPLES) {
+        double oldest = intervals.front();
+        intervals.pop_front();
+        sum -= oldest;
+        sum_squares -= oldest * oldest;
+    }
+}
+
+// This returns -log10 of the chance that the next heartbeat is still on its way.
+double PhiAccrualDetector::phi(std::chrono::steady_clock::time_point now) const {
+    if (!has_arrival || intervals.empty()) {
+        return 0.0;
+    }
+    return phi_at((silence(now) - mean()) / deviation());
+}
+
+// This returns the mean of the interval window.
+double PhiAccrualDetector::mean() const {
+    return intervals.empty() ? expected_interval : sum / static_cast<double>(intervals.size());
+}
+
+// This returns the standard deviation of the interval window, floored.
+double PhiAccrualDetector::deviation() const {
+    if (intervals.empty()) {
+        return MIN_STD_DEVIATION;
+    }
+    double average = mean();
+    double variance = std::max(0.0, sum_squares / static_cast<double>(intervals.size()) - average * average);
+    return std::max(MIN_STD_DEVIATION, std::sqrt(variance));
+}
+
+// This returns when phi will reach the threshold, absent new heartbeats.
+std::chrono::steady_clock::time_point PhiAccrualDetector::deadline(double deviations) const {
+    double seconds = std::max(0.0, mean() + deviations * deviation());
+    return last_arrival + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+// This converts a phi threshold into standard deviations past the mean interval.
+double phi_deviations(double threshold) {
+    // phi grows monotonically with y, so bisect
+    double low = -10.0;
+    double high = 40.0;
+    for (int i = 0; i < 100; ++i) {
+        double mid = (low + high) / 2.0;
+        if (phi_at(mid) < threshold) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+    return high;
+}
+
+// This returns the seconds since the last heartbeat.
+double PhiAccrualDetector::silence(std::chrono::steady_clock::time_point now) const {
+    if (!has_arrival) {
+        return 0.0;
+    }
+    return std::chrono::duration_cast<std::chrono::duration<double>>(now - last_arrival).count();
+}
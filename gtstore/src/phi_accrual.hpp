@@ -0,0 +1,44 @@
+#ifndef GTSTORE_PHI_ACCRUAL_HPP
+#define GTSTORE_PHI_ACCRUAL_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <deque>
+
+// NEWLY ADDED: phi-accrual failure detector (Hayashibara et al.) for one node.
+// Instead of a fixed timeout it keeps a window of heartbeat inter-arrival
+// times and reports phi = -log10(P(a heartbeat arrives later than now)), so a
+// node with jittery heartbeats earns a longer grace period than a steady one.
+class PhiAccrualDetector {
+public:
+    explicit PhiAccrualDetector(double expected_interval_seconds);
+
+    // This records a heartbeat arrival.
+    void heartbeat(std::chrono::steady_clock::time_point now);
+
+    // This returns the suspicion level for the silence since the last heartbeat.
+    double phi(std::chrono::steady_clock::time_point now) const;
+
+    // This returns the seconds since the last heartbeat.
+    double silence(std::chrono::steady_clock::time_point now) const;
+
+    // This returns when phi will reach the threshold that phi_deviations() translated, absent new heartbeats.
+    std::chrono::steady_clock::time_point deadline(double deviations) const;
+
+private:
+    double expected_interval;
+    std::deque<double> intervals;
+    double sum = 0.0;
+    double sum_squares = 0.0;
+    std::chrono::steady_clock::time_point last_arrival;
+    bool has_arrival = false;
+
+    void add_interval(double seconds);
+    double mean() const;
+    double deviation() const;
+};
+
+// This converts a phi threshold into standard deviations past the mean interval.
+double phi_deviations(double threshold);
+
+#endif
@@ -0,0 +1,322 @@
+#include "routing.hpp"
+#include "hash.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+// This scrambles a 64-bit value (splitmix64 finalizer).
+inline uint64_t mix64(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+// This is the weighted HRW score -w / ln(u) with u uniform in (0, 1).
+inline double rendezvous_score(uint64_t key_hash, uint64_t node_seed, uint32_t weight) {
+    double unit = (static_cast<double>(mix64(key_hash ^ node_seed) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+    return -static_cast<double>(std::max<uint32_t>(1, weight)) / std::log(unit);
+}
+}
+
+// This rebuilds the lookup structures from a table snapshot.
+void RoutingIndex::rebuild(const TableSnapshot &table) {
+    snapshot = table;
+    std::sort(snapshot.nodes.begin(), snapshot.nodes.end(), [](const StorageNodeInfo &lhs, const StorageNodeInfo &rhs) {
+        return lhs.token < rhs.token;
+    });
+    // placement runs over the nodes that stay; a table draining every node keeps them all
+    draining_ids.clear();
+    draining_ids.insert(snapshot.draining.begin(), snapshot.draining.end());
+    placed.clear();
+    for (const auto &node : snapshot.nodes) {
+        if (draining_ids.count(node.node_id) == 0) {
+            placed.push_back(node);
+        }
+    }
+    if (placed.empty()) {
+        placed = snapshot.nodes;
+        draining_ids.clear();
+    }
+    before_drain.reset();
+    if (placed.size() != snapshot.nodes.size()) {
+        TableSnapshot full = snapshot;
+        full.draining.clear();
+        std::shared_ptr<RoutingIndex> index = std::make_shared<RoutingIndex>();
+        index->rebuild(full);
+        before_drain = index;
+    }
+    std::vector<StorageNodeInfo> &ring = placed;
+    tokens.clear();
+    tokens.reserve(ring.size());
+    for (const auto &node : ring) {
+        tokens.push_back(node.token);
+    }
+
+    // one bucket per distinct node, in token order, for the HRW mode
+    buckets.clear();
+    bucket_seeds.clear();
+    jump_slots.clear();
+    std::unordered_set<std::string> distinct_ids;
+    for (size_t i = 0; i < ring.size(); ++i) {
+        if (distinct_ids.insert(ring[i].node_id).second) {
+            buckets.push_back(static_cast<uint32_t>(i));
+            bucket_seeds.push_back(ring_hash(ring[i].node_id));
+        }
+    }
+    // jump buckets are indexed by the manager's bucket id; ids of departed nodes stay vacant (-1)
+    if (snapshot.placement == PlacementMode::JUMP) {
+        for (uint32_t entry : buckets) {
+            uint32_t bucket = ring[entry].bucket;
+            if (bucket >= jump_slots.size()) {
+                jump_slots.resize(bucket + 1, -1);
+            }
+            if (jump_slots[bucket] < 0) {
+                jump_slots[bucket] = static_cast<int32_t>(entry);
+            }
+        }
+    }
+    replicas = std::min(std::max<size_t>(1, snapshot.replication_factor), buckets.size());
+    hot_keys.clear();
+    hot_keys.insert(snapshot.hot_keys.begin(), snapshot.hot_keys.end());
+
+    preferences.clear();
+    keep_percent.clear();
+    if (snapshot.placement != PlacementMode::RING && snapshot.placement != PlacementMode::BOUNDED) {
+        return;
+    }
+    // bounded lists run past the replicas by one node per capped node, so spilled keys have somewhere to go
+    size_t list_length = replicas;
+    if (snapshot.placement == PlacementMode::BOUNDED) {
+        std::unordered_map<std::string, uint32_t> caps;
+        for (const auto &share : snapshot.load_shares) {
+            if (share.keep_percent < 100) {
+                caps[share.node_id] = share.keep_percent;
+            }
+        }
+        keep_percent.assign(ring.size(), 100);
+        for (size_t i = 0; i < ring.size(); ++i) {
+            auto cap = caps.find(ring[i].node_id);
+            if (cap != caps.end()) {
+                keep_percent[i] = cap->second;
+            }
+        }
+        list_length = std::min(replicas + caps.size(), buckets.size());
+    }
+    // walk successors once per token so lookups never skip duplicates at request time
+    preferences.assign(ring.size(), std::vector<uint32_t>());
+    for (size_t slot = 0; slot < ring.size(); ++slot) {
+        std::vector<uint32_t> &list = preferences[slot];
+        list.reserve(list_length);
+        for (size_t step = 0; step < ring.size() && list.size() < list_length; ++step) {
+            uint32_t candidate = static_cast<uint32_t>((slot + step) % ring.size());
+            bool seen = false;
+            for (uint32_t chosen : list) {
+                if (ring[chosen].node_id == ring[candidate].node_id) {
+                    seen = true;
+                    break;
+                }
+            }
+            if (!seen) {
+                list.push_back(candidate);
+            }
+        }
+    }
+}
+
+// This finds the first token at or after the hash, wrapping to slot 0.
+size_t RoutingIndex::slot_for(uint64_t key_hash) const {
+    auto it = std::lower_bound(tokens.begin(), tokens.end(), key_hash);
+    if (it == tokens.end()) {
+        return 0;
+    }
+    return static_cast<size_t>(it - tokens.begin());
+}
+
+// This returns how many distinct replicas serve the key hash.
+size_t RoutingIndex::replica_count(uint64_t key_hash) const {
+    if (placed.empty()) {
+        return 0;
+    }
+    if (snapshot.placement == PlacementMode::RING || snapshot.placement == PlacementMode::BOUNDED) {
+        return preferences.empty() ? 0 : std::min(replicas, preferences[slot_for(key_hash)].size());
+    }
+    return replicas;
+}
+
+// This returns the Nth replica for the key hash.
+const StorageNodeInfo *RoutingIndex::replica_for(uint64_t key_hash, size_t attempt) const {
+    if (placed.empty() || attempt >= replicas) {
+        return nullptr;
+    }
+    switch (snapshot.placement) {
+    case PlacementMode::RENDEZVOUS:
+        return rendezvous_replica(key_hash, attempt);
+    case PlacementMode::BOUNDED:
+        return bounded_replica(key_hash, attempt);
+    case PlacementMode::JUMP:
+        return jump_replica(key_hash, attempt);
+    default: {
+        if (preferences.empty()) {
+            return nullptr;
+        }
+        const std::vector<uint32_t> &list = preferences[slot_for(key_hash)];
+        if (attempt >= list.size()) {
+            return nullptr;
+        }
+        return &placed[list[attempt]];
+    }
+    }
+}
+
+// This counts the replicas plus the draining nodes that replicated the key before they started to leave.
+size_t RoutingIndex::read_count(uint64_t key_hash) const {
+    size_t count = replica_count(key_hash);
+    if (!before_drain) {
+        return count;
+    }
+    for (size_t attempt = 0; attempt < before_drain->replica_count(key_hash); ++attempt) {
+        const StorageNodeInfo *node = before_drain->replica_for(key_hash, attempt);
+        if (node && draining_ids.count(node->node_id) != 0) {
+            ++count;
+        }
+    }
+    return count;
+}
+
+// This returns the replicas first, then the draining nodes in their old replica order, which hold keys the
+// replicas may not have been handed yet.
+const StorageNodeInfo *RoutingIndex::read_replica(uint64_t key_hash, size_t attempt) const {
+    size_t count = replica_count(key_hash);
+    if (attempt < count) {
+        return replica_for(key_hash, attempt);
+    }
+    if (!before_drain) {
+        return nullptr;
+    }
+    size_t fallback = attempt - count;
+    for (size_t old = 0; old < before_drain->replica_count(key_hash); ++old) {
+        const StorageNodeInfo *node = before_drain->replica_for(key_hash, old);
+        if (node && draining_ids.count(node->node_id) != 0 && fallback-- == 0) {
+            return node;
+        }
+    }
+    return nullptr;
+}
+
+// This returns the index over the whole table, used to find who held a key before the drains began.
+const RoutingIndex &RoutingIndex::undrained() const {
+    return before_drain ? *before_drain : *this;
+}
+
+// This ranks nodes by HRW score and returns the Nth best.
+const StorageNodeInfo *RoutingIndex::rendezvous_replica(uint64_t key_hash, size_t attempt) const {
+    if (attempt == 0) {
+        size_t best = 0;
+        double best_score = -1.0;
+        for (size_t b = 0; b < buckets.size(); ++b) {
+            double score = rendezvous_score(key_hash, bucket_seeds[b], placed[buckets[b]].weight);
+            if (score > best_score) {
+                best_score = score;
+                best = b;
+            }
+        }
+        return &placed[buckets[best]];
+    }
+    std::vector<std::pair<double, size_t>> ranked;
+    ranked.reserve(buckets.size());
+    for (size_t b = 0; b < buckets.size(); ++b) {
+        ranked.emplace_back(rendezvous_score(key_hash, bucket_seeds[b], placed[buckets[b]].weight), b);
+    }
+    std::nth_element(ranked.begin(), ranked.begin() + attempt, ranked.end(),
+                     [](const std::pair<double, size_t> &lhs, const std::pair<double, size_t> &rhs) {
+                         return lhs.first > rhs.first || (lhs.first == rhs.first && lhs.second < rhs.second);
+                     });
+    return &placed[buckets[ranked[attempt].second]];
+}
+
+// This jumps to a bucket, rehashing into the lower buckets while it lands on a vacant one, then
+// takes the next live buckets in id order as the further replicas.
+const StorageNodeInfo *RoutingIndex::jump_replica(uint64_t key_hash, size_t attempt) const {
+    size_t slot = static_cast<size_t>(jump_consistent_hash(key_hash, static_cast<int32_t>(jump_slots.size())));
+    uint64_t probe = key_hash;
+    while (jump_slots[slot] < 0 && slot > 0) {
+        probe = mix64(probe ^ slot);
+        slot = static_cast<size_t>(jump_consistent_hash(probe, static_cast<int32_t>(slot)));
+    }
+    for (size_t step = 0; step < jump_slots.size(); ++step) {
+        int32_t entry = jump_slots[(slot + step) % jump_slots.size()];
+        if (entry >= 0 && attempt-- == 0) {
+            return &placed[static_cast<size_t>(entry)];
+        }
+    }
+    return nullptr;
+}
+
+// This walks the successor list, passing over capped nodes that shed this key.
+const StorageNodeInfo *RoutingIndex::bounded_replica(uint64_t key_hash, size_t attempt) const {
+    const std::vector<uint32_t> &list = preferences[slot_for(key_hash)];
+    // the same draw for every node, so a key shed by one capped node is shed by the next one too
+    uint32_t draw = static_cast<uint32_t>(mix64(key_hash) % 100);
+    size_t accepted = 0;
+    for (uint32_t entry : list) {
+        if (draw < keep_percent[entry] && accepted++ == attempt) {
+            return &placed[entry];
+        }
+    }
+    // too few nodes have room: fall back to the capped ones in ring order
+    size_t skipped = 0;
+    for (uint32_t entry : list) {
+        if (draw >= keep_percent[entry] && accepted + skipped++ == attempt) {
+            return &placed[entry];
+        }
+    }
+    return nullptr;
+}
+
+// This returns the ring entries sorted by token.
+const std::vector<StorageNodeInfo> &RoutingIndex::entries() const {
+    return snapshot.nodes;
+}
+
+// This returns the snapshot the index was built from.
+const TableSnapshot &RoutingIndex::table() const {
+    return snapshot;
+}
+
+// This reports whether the ring has no entries.
+bool RoutingIndex::empty() const {
+    return snapshot.nodes.empty();
+}
+
+// This reports whether the manager flagged the key hash as hot.
+bool RoutingIndex::is_hot(uint64_t key_hash) const {
+    return !hot_keys.empty() && hot_keys.count(key_hash) > 0;
+}
+
+// This derives the index-th ring token the manager assigns to a node.
+uint64_t node_token(const std::string &node_id, const NodeAddress &address, size_t index) {
+    std::string seed = node_id + "-" + address.host + ":" + std::to_string(address.port);
+    if (index > 0) {
+        seed += "#" + std::to_string(index);
+    }
+    return ring_hash(seed);
+}
+
+// This maps a key hash onto one of num_buckets buckets.
+int32_t jump_consistent_hash(uint64_t key_hash, int32_t num_buckets) {
+    int64_t bucket = -1;
+    int64_t next = 0;
+    while (next < num_buckets) {
+        bucket = next;
+        key_hash = key_hash * 2862933555777941757ULL + 1;
+        next = static_cast<int64_t>(static_cast<double>(bucket + 1) *
+                                    (static_cast<double>(1LL << 31) / static_cast<double>((key_hash >> 33) + 1)));
+    }
+    return static_cast<int32_t>(bucket);
+}
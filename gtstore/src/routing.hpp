@@ -0,0 +1,84 @@
+#ifndef GTSTORE_ROUTING_HPP
+#define GTSTORE_ROUTING_HPP
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "net_common.hpp"
+
+// NEWLY ADDED: key placement over a routing table snapshot.
+// RING uses a sorted token array with replica lists precomputed per token.
+// RENDEZVOUS scores every node with weighted highest-random-weight hashing.
+// JUMP maps keys to the bucket ids the manager assigned with jump consistent
+// hash and takes the following live buckets as replicas; a key landing on a
+// vacant bucket is rehashed into the buckets below it, so a departure anywhere
+// only moves that node's keys. RING is weighted through the
+// number of tokens a node owns, RENDEZVOUS through the weight in its score;
+// JUMP has no weighting. BOUNDED is the ring with load caps: a node the
+// manager marks as over its cap keeps only its published share of keys and
+// the rest spill to the next node on the ring. Nodes the table lists as
+// draining are left out of placement; reads fall back to them afterwards.
+class RoutingIndex {
+public:
+    // This rebuilds the lookup structures from a table snapshot.
+    void rebuild(const TableSnapshot &table);
+
+    // This finds the ring slot owning the key hash with a binary search.
+    size_t slot_for(uint64_t key_hash) const;
+
+    // This returns how many distinct replicas serve the key hash.
+    size_t replica_count(uint64_t key_hash) const;
+
+    // This returns the Nth replica for the key hash, or nullptr past the list.
+    const StorageNodeInfo *replica_for(uint64_t key_hash, size_t attempt) const;
+
+    // This returns how many nodes may hold the key hash: its replicas, then the draining nodes it is leaving.
+    size_t read_count(uint64_t key_hash) const;
+
+    // This returns the Nth node to read the key hash from, or nullptr past the list.
+    const StorageNodeInfo *read_replica(uint64_t key_hash, size_t attempt) const;
+
+    // This returns the placement over every node, draining ones included; without any that is this index.
+    const RoutingIndex &undrained() const;
+
+    // This returns the ring entries sorted by token.
+    const std::vector<StorageNodeInfo> &entries() const;
+
+    // This returns the snapshot the index was built from, entries sorted by token.
+    const TableSnapshot &table() const;
+
+    // This reports whether the ring has no entries.
+    bool empty() const;
+
+    // This reports whether the manager flagged the key hash as hot.
+    bool is_hot(uint64_t key_hash) const;
+
+private:
+    TableSnapshot snapshot{};
+    std::vector<StorageNodeInfo> placed;
+    std::unordered_set<std::string> draining_ids;
+    std::shared_ptr<const RoutingIndex> before_drain;
+    size_t replicas = 0;
+    std::vector<uint64_t> tokens;
+    std::vector<std::vector<uint32_t>> preferences;
+    std::vector<uint32_t> keep_percent;
+    std::vector<uint32_t> buckets;
+    std::vector<uint64_t> bucket_seeds;
+    std::vector<int32_t> jump_slots;
+    std::unordered_set<uint64_t> hot_keys;
+
+    const StorageNodeInfo *rendezvous_replica(uint64_t key_hash, size_t attempt) const;
+    const StorageNodeInfo *jump_replica(uint64_t key_hash, size_t attempt) const;
+    const StorageNodeInfo *bounded_replica(uint64_t key_hash, size_t attempt) const;
+};
+
+// This derives the index-th ring token the manager assigns to a node.
+uint64_t node_token(const std::string &node_id, const NodeAddress &address, size_t index);
+
+// This maps a key hash onto one of num_buckets buckets (Lamping and Veach).
+int32_t jump_consistent_hash(uint64_t key_hash, int32_t num_buckets);
+
+#endif
@@ -0,0 +1,54 @@
+#include "sketch.hpp"
+
+#include <algorithm>
+
+// This sizes the counter matrix and heavy-hitter list.
+HotKeyTracker::HotKeyTracker(size_t width, size_t depth, uint32_t threshold, size_t max_hot)
+    : width(std::max<size_t>(1, width)),
+      depth(std::max<size_t>(1, depth)),
+      threshold(std::max<uint32_t>(1, threshold)),
+      max_hot(max_hot),
+      counters(new std::atomic<uint32_t>[this->width * this->depth]) {
+    for (size_t i = 0; i < this->width * this->depth; ++i) {
+        counters[i] = 0;
+    }
+}
+
+// This picks the counter for a row from an independent remix of the key hash.
+size_t HotKeyTracker::cell(size_t row, uint64_t key_hash) const {
+    uint64_t value = key_hash + (row + 1) * 0x9E3779B97F4A7C15ULL;
+    value ^= value >> 32;
+    value *= 0xD6E8FEB86659FD93ULL;
+    value ^= value >> 32;
+    return row * width + static_cast<size_t>(value % width);
+}
+
+// This counts one request and promotes the key once its estimate reaches the threshold.
+void HotKeyTracker::record(uint64_t key_hash) {
+    uint32_t estimate = UINT32_MAX;
+    for (size_t row = 0; row < depth; ++row) {
+        uint32_t count = counters[cell(row, key_hash)].fetch_add(1) + 1;
+        estimate = std::min(estimate, count);
+    }
+    if (estimate < threshold) {
+        return;
+    }
+    // only keys already over the threshold reach the lock
+    std::lock_guard<std::mutex> guard(hot_mutex);
+    if (hot.size() < max_hot && std::find(hot.begin(), hot.end(), key_hash) == hot.end()) {
+        hot.push_back(key_hash);
+    }
+}
+
+// This returns the window's heavy hitters and clears the counters.
+std::vector<uint64_t> HotKeyTracker::drain_window() {
+    std::vector<uint64_t> result;
+    {
+        std::lock_guard<std::mutex> guard(hot_mutex);
+        result.swap(hot);
+    }
+    for (size_t i = 0; i < width * depth; ++i) {
+        counters[i] = 0;
+    }
+    return result;
+}
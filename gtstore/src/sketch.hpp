@@ -0,0 +1,35 @@
+#ifndef GTSTORE_SKETCH_HPP
+#define GTSTORE_SKETCH_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// NEWLY ADDED: count-min sketch over key hashes with a heavy-hitter list.
+// Counters are atomics so request threads can record without a lock; only
+// keys whose estimate reaches the threshold touch the mutex-guarded list.
+class HotKeyTracker {
+public:
+    HotKeyTracker(size_t width, size_t depth, uint32_t threshold, size_t max_hot);
+
+    // This counts one request for the key hash.
+    void record(uint64_t key_hash);
+
+    // This returns the heavy hitters of the current window and starts a new one.
+    std::vector<uint64_t> drain_window();
+
+private:
+    size_t width;
+    size_t depth;
+    uint32_t threshold;
+    size_t max_hot;
+    std::unique_ptr<std::atomic<uint32_t>[]> counters;
+    std::vector<uint64_t> hot;
+    std::mutex hot_mutex;
+
+    size_t cell(size_t row, uint64_t key_hash) const;
+};
+
+#endif
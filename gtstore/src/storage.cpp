@@ -1,8 +1,14 @@
 #include "gtstore.hpp"
+#include "codec.hpp"
+#include "crc32c.hpp"
+#include "hash.hpp"
+#include "messages.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
 #include <cstdlib>
 #include <sstream>
+#include <sys/time.h>
 #include <thread>
 
 using namespace gtstore_utils;
@@ -10,6 +16,46 @@ using namespace gtstore_utils;
 namespace {
 const std::string COMPONENT_PREFIX = "storage_";
 const int BACKLOG = 16;
+// count-min sketch shape and per heartbeat window hot-key threshold
+const size_t HOT_SKETCH_WIDTH = 1024;
+const size_t HOT_SKETCH_DEPTH = 4;
+const uint32_t DEFAULT_HOT_THRESHOLD = 200;
+const size_t MAX_HOT_KEYS = 16;
+// a drain pass that could not reach every new owner is retried this often
+const auto DRAIN_RETRY = std::chrono::seconds(1);
+const int MAX_DRAIN_PASSES = 30;
+// a retired node keeps answering WRONG_OWNER this long for clients still on the old table
+const auto RETIRE_GRACE = std::chrono::seconds(5);
+
+// This renders a stored value for logs without expanding compressed or streamed ones.
+std::string show_value(const StoredValue &value) {
+	StreamManifest manifest;
+	if (value.chunks && decode_message<MessageType::STREAM_END>(value.bytes, manifest)) {
+		return "<stream " + std::to_string(manifest.chunk_count) + " chunks, " + std::to_string(manifest.total_bytes) + " bytes>";
+	}
+	if (value.flags & MESSAGE_FLAG_COMPRESSED) {
+		return "<lz " + std::to_string(value.bytes.size()) + " bytes>";
+	}
+	return describe_value(value.bytes);
+}
+
+// This tells whether two tables cap the same nodes at the same shares.
+bool same_load_shares(const std::vector<NodeLoadShare> &lhs, const std::vector<NodeLoadShare> &rhs) {
+	return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](const NodeLoadShare &a, const NodeLoadShare &b) {
+		return a.node_id == b.node_id && a.keep_percent == b.keep_percent;
+	});
+}
+
+// This writes a streamed value back out: every chunk in order, then the manifest.
+// Chunks go out back to back; the receiver acknowledges once, after the manifest.
+bool send_stream_body(int fd, const std::vector<std::string> &chunks, const std::string &manifest) {
+	for (const auto &chunk : chunks) {
+		if (!send_message(fd, MessageType::STREAM_CHUNK, chunk)) {
+			return false;
+		}
+	}
+	return send_message(fd, MessageType::STREAM_END, manifest);
+}
 }
 
 // This tells manager about this storage node.
@@ -20,8 +66,7 @@ void GTStoreStorage::register_with_manager() {
 		log_line("ERROR", "could not reach manager");
 		return;
 	}
-	std::string payload = storage_id + ",127.0.0.1," + std::to_string(listen_port);
-	if (!send_message(fd, MessageType::STORAGE_REGISTER, payload)) {
+	if (!send_typed<MessageType::STORAGE_REGISTER>(fd, {listen_port, capacity_weight, storage_id, "127.0.0.1"})) {
 		log_line("ERROR", "failed to send register");
 		close(fd);
 		return;
@@ -29,36 +74,117 @@ void GTStoreStorage::register_with_manager() {
 	MessageType type;
 	std::string table_payload;
 	if (recv_message(fd, type, table_payload) && type == MessageType::TABLE_PUSH) {
-		size_t parsed_factor = 1;
-		auto nodes = parse_table_payload(table_payload, parsed_factor);
-		replication_factor = parsed_factor;
-		log_line("INFO", "Received table with " + std::to_string(nodes.size()) + " nodes at replication " + std::to_string(replication_factor));
+		TableSnapshot parsed = parse_table_payload(table_payload);
+		if (parsed.epoch == 0 || parsed.nodes.empty()) {
+			log_line("WARN", "Registration reply carried an unusable table, keeping the current one");
+			close(fd);
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> guard(table_mutex);
+			replication_factor = parsed.replication_factor;
+			table = parsed;
+			ring.rebuild(table);
+			if (gossip) {
+				gossip->observe_table(table.nodes);
+			}
+		}
+		log_line("INFO", "Received table epoch " + std::to_string(parsed.epoch) + " with " + std::to_string(parsed.nodes.size()) + " nodes at replication " + std::to_string(replication_factor));
 	}
 	close(fd);
 }
 
-// This sends heartbeat messages to manager.
+// This catches the local table copy up after the manager pushes a new epoch. The fetch and the index
+// rebuild run on a private copy; table_mutex is only held to read the current table and to swap the new one in,
+// so gets and puts never wait on a manager round trip.
+void GTStoreStorage::sync_table_from_manager(uint64_t announced_epoch) {
+	NodeAddress manager_addr{DEFAULT_MANAGER_HOST, DEFAULT_MANAGER_PORT};
+	TableSnapshot before;
+	{
+		std::lock_guard<std::mutex> guard(table_mutex);
+		if (announced_epoch == table.epoch) {
+			return;
+		}
+		before = table;
+	}
+	TableSnapshot fresh = before;
+	if (sync_table(manager_addr, fresh) != SyncResult::UPDATED) {
+		return;
+	}
+	RoutingIndex fresh_ring;
+	fresh_ring.rebuild(fresh);
+	{
+		std::lock_guard<std::mutex> guard(table_mutex);
+		// a registration installed its own reply while we were fetching; that one is at least as current.
+		// Epochs are not compared directly, since a manager restarted without its state file counts from 1 again.
+		if (table.epoch != before.epoch) {
+			return;
+		}
+		replication_factor = fresh.replication_factor;
+		table = fresh;
+		ring = std::move(fresh_ring);
+	}
+	if (gossip) {
+		gossip->observe_table(fresh.nodes);
+	}
+	log_line("INFO", "Table now at epoch " + std::to_string(fresh.epoch) + " with " + std::to_string(fresh.nodes.size()) + " nodes");
+	if (fresh.placement == PlacementMode::BOUNDED && !before.nodes.empty() && !same_load_shares(before.load_shares, fresh.load_shares)) {
+		std::thread(&GTStoreStorage::rebalance_after_share_change, this, std::move(before)).detach();
+	}
+}
+
+// This sends heartbeat messages to manager (id, request count, hot keys, dead peers) covering the window since the last one.
+// The connection stays open between beats and is only re-dialled after it breaks.
 void GTStoreStorage::heartbeat_loop() {
+	NodeAddress manager_addr{DEFAULT_MANAGER_HOST, DEFAULT_MANAGER_PORT};
+	int fd = -1;
+	std::string heartbeat;
 	while (running) {
 		std::this_thread::sleep_for(std::chrono::seconds(2));
-		NodeAddress manager_addr{DEFAULT_MANAGER_HOST, DEFAULT_MANAGER_PORT};
-		int fd = connect_to_host(manager_addr);
 		if (fd < 0) {
-			continue;
+			fd = connect_to_host(manager_addr);
+			if (fd < 0) {
+				continue;
+			}
+			// a wedged manager should cost one beat, not the heartbeat thread
+			timeval ack_timeout{};
+			ack_timeout.tv_sec = 2;
+			setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &ack_timeout, sizeof(ack_timeout));
 		}
-		if (!send_message(fd, MessageType::HEARTBEAT, storage_id)) {
-			close(fd);
-			continue;
+		Heartbeat beat{window_requests.exchange(0), storage_id, hot_keys->drain_window(), {}};
+		if (!beat.hot_keys.empty()) {
+			log_line("INFO", "Reporting " + std::to_string(beat.hot_keys.size()) + " hot keys");
+		}
+		std::vector<std::string> dead;
+		if (gossip) {
+			dead = gossip->dead_members();
 		}
+		beat.dead.assign(dead.begin(), dead.end());
+		// the beat is written into one buffer that keeps its capacity from beat to beat
+		heartbeat.clear();
+		encode_message<MessageType::HEARTBEAT>(beat, heartbeat);
 		MessageType type;
 		std::string payload;
-		recv_message(fd, type, payload);
+		HeartbeatAck ack{HeartbeatAction::OK};
+		if (!send_message(fd, MessageType::HEARTBEAT, heartbeat) || !recv_message(fd, type, payload) ||
+		    type != MessageType::HEARTBEAT_ACK || !decode_message<MessageType::HEARTBEAT_ACK>(payload, ack)) {
+			log_line("WARN", "Heartbeat channel to manager lost, reconnecting");
+			close(fd);
+			fd = -1;
+		} else if (ack.action == HeartbeatAction::REGISTER && !draining) {
+			log_line("WARN", "Manager no longer lists " + storage_id + ", registering again");
+			register_with_manager();
+		} else if (ack.action == HeartbeatAction::DRAIN && !draining.exchange(true)) {
+			std::thread(&GTStoreStorage::drain_and_retire, this).detach();
+		}
+	}
+	if (fd >= 0) {
 		close(fd);
 	}
 }
 
 // This checks the key size.
-bool GTStoreStorage::key_valid(const std::string &key) {
+bool GTStoreStorage::key_valid(std::string_view key) {
 	return !key.empty() && key.size() <= MAX_KEY_BYTE_PER_REQUEST;
 }
 
@@ -67,43 +193,481 @@ bool GTStoreStorage::value_valid(const std::string &value) {
 	return value.size() <= MAX_VALUE_BYTE_PER_REQUEST;
 }
 
+// This checks whether the current table places the key on this node. A draining node takes no writes
+// but still serves reads of the keys it is handing off.
+bool GTStoreStorage::owns_key(const std::string &key, uint64_t &epoch, bool reading) {
+	uint64_t key_hash = ring_hash(key);
+	std::lock_guard<std::mutex> guard(table_mutex);
+	epoch = table.epoch;
+	// before the first table arrives there is nothing to check against
+	if (ring.empty()) {
+		return true;
+	}
+	size_t replicas = reading ? ring.read_count(key_hash) : ring.replica_count(key_hash);
+	for (size_t attempt = 0; attempt < replicas; ++attempt) {
+		const StorageNodeInfo *node = reading ? ring.read_replica(key_hash, attempt) : ring.replica_for(key_hash, attempt);
+		if (node && node->node_id == storage_id) {
+			return true;
+		}
+	}
+	return false;
+}
+
 // This stores a key locally.
-void GTStoreStorage::handle_put(int client_fd, const std::string &payload) {
-	auto pos = payload.find('|');
-	if (pos == std::string::npos) {
+// Compressed values are kept compressed and served back with the same flag.
+void GTStoreStorage::handle_put(int client_fd, const std::string &payload, uint16_t flags) {
+	PutRequest request;
+	if (!decode_message<MessageType::CLIENT_PUT>(payload, request)) {
 		send_message(client_fd, MessageType::ERROR, "bad put");
 		return;
 	}
-	std::string key = payload.substr(0, pos);
-	std::string value = payload.substr(pos + 1);
+	std::string key(request.key);
+	StoredValue value{std::string(request.value), static_cast<uint16_t>(flags & MESSAGE_FLAG_COMPRESSED), nullptr, 0};
 	if (!key_valid(key)) {
 		send_message(client_fd, MessageType::ERROR, "bad key");
 		return;
 	}
-	if (!value_valid(value)) {
+	if (!value_valid(value.bytes)) {
 		send_message(client_fd, MessageType::ERROR, "bad value");
 		return;
 	}
-	log_line("INFO", "PUT key=" + key + " value=" + value + " on " + storage_id);
-	kv_store[key] = value;
-	log_current_store();
+	uint64_t epoch = 0;
+	if (!owns_key(key, epoch, false)) {
+		log_line("WARN", "PUT rejected key=" + key + " not owned by " + storage_id + " at epoch " + std::to_string(epoch));
+		send_typed<MessageType::WRONG_OWNER>(client_fd, {epoch});
+		return;
+	}
+	bool sealed = false;
+	{
+		// a drain in progress picks the write up by its sequence number on the next pass
+		std::lock_guard<std::mutex> guard(store_mutex);
+		sealed = writes_sealed;
+		if (!sealed) {
+			value.seq = ++write_seq;
+			kv_store[key] = value;
+			log_current_store();
+		}
+	}
+	if (sealed) {
+		log_line("WARN", "PUT rejected key=" + key + ", " + storage_id + " is retiring");
+		send_typed<MessageType::WRONG_OWNER>(client_fd, {epoch});
+		return;
+	}
+	++window_requests;
+	log_line("INFO", "PUT key=" + key + " value=" + show_value(value) + " on " + storage_id);
 	send_message(client_fd, MessageType::PUT_OK, "ok");
 }
 
+// This stores a key handed off by a draining node, or copied after a load share change. A copy flagged
+// MESSAGE_FLAG_KEEP_EXISTING does not replace a value a client already wrote here.
+void GTStoreStorage::handle_replica_put(int client_fd, const std::string &payload, uint16_t flags) {
+	PutRequest request;
+	if (!decode_message<MessageType::REPL_PUT>(payload, request) || !key_valid(request.key)) {
+		send_message(client_fd, MessageType::ERROR, "bad handoff");
+		return;
+	}
+	std::string key(request.key);
+	StoredValue value{std::string(request.value), static_cast<uint16_t>(flags & MESSAGE_FLAG_COMPRESSED), nullptr, 0};
+	bool stored = true;
+	{
+		std::lock_guard<std::mutex> guard(store_mutex);
+		value.seq = ++write_seq;
+		if (flags & MESSAGE_FLAG_KEEP_EXISTING) {
+			stored = kv_store.emplace(key, value).second;
+		} else {
+			kv_store[key] = value;
+		}
+	}
+	log_line("INFO", std::string(stored ? "Handoff PUT key=" : "Handoff PUT kept existing key=") + key + " on " + storage_id);
+	send_message(client_fd, MessageType::REPL_ACK, "ok");
+}
+
+// This receives a streamed value: STREAM_READY once the key is accepted, then STREAM_CHUNK frames that are
+// appended to a chunk list as they arrive, then STREAM_END with the manifest. The value replaces the key only
+// after the manifest matches what arrived, so readers never see a partial stream.
+void GTStoreStorage::handle_stream_put(int client_fd, const std::string &payload, uint16_t flags, bool handoff) {
+	KeyRequest request;
+	if (!decode_message<MessageType::STREAM_PUT>(payload, request) || !key_valid(request.key)) {
+		send_message(client_fd, MessageType::ERROR, "bad key");
+		return;
+	}
+	std::string key(request.key);
+	uint64_t epoch = 0;
+	if (!handoff && !owns_key(key, epoch, false)) {
+		log_line("WARN", "Stream PUT rejected key=" + key + " not owned by " + storage_id + " at epoch " + std::to_string(epoch));
+		send_typed<MessageType::WRONG_OWNER>(client_fd, {epoch});
+		return;
+	}
+	if (!send_message(client_fd, MessageType::STREAM_READY, "ready")) {
+		return;
+	}
+	std::shared_ptr<std::vector<std::string>> chunks = std::make_shared<std::vector<std::string>>();
+	uint64_t total = 0;
+	uint32_t checksum = 0;
+	MessageType type = MessageType::ERROR;
+	std::string frame;
+	while (recv_message(client_fd, type, frame) && type == MessageType::STREAM_CHUNK) {
+		if (frame.size() > STREAM_CHUNK_BYTES || total + frame.size() > MAX_STREAM_VALUE_BYTES) {
+			log_line("WARN", "Stream PUT key=" + key + " exceeds limits, discarded");
+			send_message(client_fd, MessageType::ERROR, "stream too large");
+			return;
+		}
+		checksum = crc32c_extend(checksum, frame.data(), frame.size());
+		total += frame.size();
+		chunks->push_back(std::move(frame));
+		frame.clear();
+	}
+	StreamManifest manifest;
+	if (type != MessageType::STREAM_END || !decode_message<MessageType::STREAM_END>(frame, manifest) || manifest.chunk_count != chunks->size() ||
+	    manifest.total_bytes != total || manifest.checksum != checksum) {
+		log_line("WARN", "Stream PUT key=" + key + " incomplete or inconsistent after " + std::to_string(total) + " bytes, discarded");
+		send_message(client_fd, MessageType::ERROR, "bad stream");
+		return;
+	}
+	StoredValue value{frame, 0, chunks, 0};
+	if (handoff) {
+		bool stored = true;
+		{
+			std::lock_guard<std::mutex> guard(store_mutex);
+			value.seq = ++write_seq;
+			if (flags & MESSAGE_FLAG_KEEP_EXISTING) {
+				stored = kv_store.emplace(key, value).second;
+			} else {
+				kv_store[key] = value;
+			}
+		}
+		log_line("INFO", std::string(stored ? "Handoff stream PUT key=" : "Handoff stream PUT kept existing key=") + key + " value=" + show_value(value) + " on " + storage_id);
+		send_message(client_fd, MessageType::REPL_ACK, "ok");
+		return;
+	}
+	bool sealed = false;
+	{
+		std::lock_guard<std::mutex> guard(store_mutex);
+		sealed = writes_sealed;
+		if (!sealed) {
+			value.seq = ++write_seq;
+			kv_store[key] = value;
+		}
+	}
+	if (sealed) {
+		log_line("WARN", "Stream PUT rejected key=" + key + ", " + storage_id + " is retiring");
+		send_typed<MessageType::WRONG_OWNER>(client_fd, {epoch});
+		return;
+	}
+	++window_requests;
+	log_line("INFO", "Stream PUT key=" + key + " value=" + show_value(value) + " on " + storage_id);
+	send_message(client_fd, MessageType::PUT_OK, "ok");
+}
+
+// This streams a value back chunk by chunk from a shared reference, so the store lock is not held while sending.
+void GTStoreStorage::handle_stream_get(int client_fd, const std::string &payload) {
+	KeyRequest request;
+	if (!decode_message<MessageType::STREAM_GET>(payload, request) || !key_valid(request.key)) {
+		send_message(client_fd, MessageType::ERROR, "bad key");
+		return;
+	}
+	std::string key(request.key);
+	uint64_t epoch = 0;
+	if (!owns_key(key, epoch, true)) {
+		log_line("WARN", "Stream GET rejected key=" + key + " not owned by " + storage_id + " at epoch " + std::to_string(epoch));
+		send_typed<MessageType::WRONG_OWNER>(client_fd, {epoch});
+		return;
+	}
+	++window_requests;
+	hot_keys->record(ring_hash(key));
+	StoredValue value;
+	bool found = false;
+	{
+		std::lock_guard<std::mutex> guard(store_mutex);
+		auto it = kv_store.find(key);
+		found = it != kv_store.end();
+		if (found) {
+			value = it->second;
+		}
+	}
+	if (!found) {
+		log_line("WARN", "Stream GET miss key=" + key + " on " + storage_id);
+		send_message(client_fd, MessageType::ERROR, "missing");
+		return;
+	}
+	if (!value.chunks) {
+		send_message(client_fd, MessageType::ERROR, "not streamed");
+		return;
+	}
+	log_line("INFO", "Stream GET hit key=" + key + " value=" + show_value(value) + " on " + storage_id);
+	send_stream_body(client_fd, *value.chunks, value.bytes);
+}
+
+// This lists the nodes that replicate the key once this node leaves but did not replicate it before the
+// decommissions began. Those already hold it from client writes, so they are left alone.
+std::vector<StorageNodeInfo> GTStoreStorage::handoff_targets(const std::string &key) {
+	uint64_t key_hash = ring_hash(key);
+	std::lock_guard<std::mutex> guard(table_mutex);
+	if (handoff_ring.empty() || handoff_epoch != table.epoch) {
+		// the table may not list this node as draining yet; placement without it is what counts
+		TableSnapshot remaining = table;
+		if (std::find(remaining.draining.begin(), remaining.draining.end(), storage_id) == remaining.draining.end()) {
+			remaining.draining.push_back(storage_id);
+		}
+		handoff_ring.rebuild(remaining);
+		handoff_epoch = table.epoch;
+	}
+	const RoutingIndex &before = handoff_ring.undrained();
+	std::vector<std::string> current;
+	for (size_t attempt = 0; attempt < before.replica_count(key_hash); ++attempt) {
+		const StorageNodeInfo *node = before.replica_for(key_hash, attempt);
+		if (node) {
+			current.push_back(node->node_id);
+		}
+	}
+	std::vector<StorageNodeInfo> targets;
+	for (size_t attempt = 0; attempt < handoff_ring.replica_count(key_hash); ++attempt) {
+		const StorageNodeInfo *node = handoff_ring.replica_for(key_hash, attempt);
+		if (node && node->node_id != storage_id && std::find(current.begin(), current.end(), node->node_id) == current.end()) {
+			targets.push_back(*node);
+		}
+	}
+	return targets;
+}
+
+// This copies one key to its new owners with REPL_PUT, adding the given header flags. Returns false if any of them did not ack.
+bool GTStoreStorage::hand_off(const std::string &key, const StoredValue &value, uint16_t flags) {
+	bool delivered = true;
+	for (const auto &target : handoff_targets(key)) {
+		delivered = send_handoff(target, key, value, flags) && delivered;
+	}
+	return delivered;
+}
+
+// This copies one key to one node with REPL_PUT or STREAM_REPL_PUT, adding the given header flags.
+bool GTStoreStorage::send_handoff(const StorageNodeInfo &target, const std::string &key, const StoredValue &value, uint16_t flags) {
+	int fd = connect_to_host(target.address);
+	if (fd < 0) {
+		log_line("WARN", "Handoff of key=" + key + " could not reach " + target.node_id);
+		return false;
+	}
+	MessageType type;
+	std::string reply;
+	bool acked = false;
+	if (value.chunks) {
+		acked = send_typed<MessageType::STREAM_REPL_PUT>(fd, {key}, flags) && recv_message(fd, type, reply) && type == MessageType::STREAM_READY &&
+		        send_stream_body(fd, *value.chunks, value.bytes) && recv_message(fd, type, reply) && type == MessageType::REPL_ACK;
+	} else {
+		acked = send_typed<MessageType::REPL_PUT>(fd, {key, value.bytes}, static_cast<uint16_t>(value.flags | flags)) &&
+		        recv_message(fd, type, reply) && type == MessageType::REPL_ACK;
+	}
+	close(fd);
+	if (!acked) {
+		log_line("WARN", "Handoff of key=" + key + " was not acknowledged by " + target.node_id);
+	}
+	return acked;
+}
+
+// This follows a change of bounded load shares: every key this node served under the previous table is
+// copied to the nodes the new table adds to its replica list, so a key that spills to a successor (or comes
+// back when a cap lifts) is there before reads arrive. Copies only fill missing keys; a client write that
+// already reached the new owner wins.
+void GTStoreStorage::rebalance_after_share_change(TableSnapshot before) {
+	std::lock_guard<std::mutex> pass(rebalance_mutex);
+	RoutingIndex previous;
+	previous.rebuild(before);
+	std::vector<std::pair<std::string, StoredValue>> items;
+	{
+		std::lock_guard<std::mutex> guard(store_mutex);
+		items.reserve(kv_store.size());
+		for (const auto &entry : kv_store) {
+			items.push_back(entry);
+		}
+	}
+	size_t copied = 0;
+	size_t failed = 0;
+	for (const auto &item : items) {
+		uint64_t key_hash = ring_hash(item.first);
+		std::vector<std::string> old_replicas;
+		for (size_t attempt = 0; attempt < previous.replica_count(key_hash); ++attempt) {
+			const StorageNodeInfo *node = previous.replica_for(key_hash, attempt);
+			if (node) {
+				old_replicas.push_back(node->node_id);
+			}
+		}
+		if (std::find(old_replicas.begin(), old_replicas.end(), storage_id) == old_replicas.end()) {
+			continue;
+		}
+		std::vector<StorageNodeInfo> targets;
+		{
+			std::lock_guard<std::mutex> guard(table_mutex);
+			for (size_t attempt = 0; attempt < ring.replica_count(key_hash); ++attempt) {
+				const StorageNodeInfo *node = ring.replica_for(key_hash, attempt);
+				if (node && node->node_id != storage_id && std::find(old_replicas.begin(), old_replicas.end(), node->node_id) == old_replicas.end()) {
+					targets.push_back(*node);
+				}
+			}
+		}
+		for (const auto &target : targets) {
+			if (send_handoff(target, item.first, item.second, MESSAGE_FLAG_KEEP_EXISTING)) {
+				++copied;
+			} else {
+				++failed;
+			}
+		}
+	}
+	log_line("INFO", "Load share change: copied " + std::to_string(copied) + " keys to new replicas" +
+	         (failed ? ", " + std::to_string(failed) + " copies failed" : std::string()));
+}
+
+// This drains the node after the manager asked for its decommission: copy every key to the nodes that
+// take over its ranges, report DRAIN_DONE so the manager drops it from the table, then leave once clients
+// still holding the old table have had time to be redirected. Writes keep landing while it runs and are
+// reconciled by sequence number: each pass resends only keys written since the last complete pass, and
+// the store is sealed in the same critical section that finds nothing left, so no write slips past the end.
+void GTStoreStorage::drain_and_retire() {
+	log_line("INFO", "Decommission requested, draining " + storage_id);
+	uint64_t drain_start = 0;
+	{
+		std::lock_guard<std::mutex> guard(store_mutex);
+		drain_start = write_seq;
+	}
+	uint64_t handed_through = 0;
+	bool drained = false;
+	for (int pass = 0; pass < MAX_DRAIN_PASSES && !drained; ++pass) {
+		std::vector<std::pair<std::string, StoredValue>> items;
+		uint64_t pass_seq = 0;
+		{
+			std::lock_guard<std::mutex> guard(store_mutex);
+			pass_seq = write_seq;
+			for (const auto &entry : kv_store) {
+				if (entry.second.seq > handed_through) {
+					items.push_back(entry);
+				}
+			}
+			if (items.empty()) {
+				writes_sealed = true;
+				drained = true;
+			}
+		}
+		if (drained) {
+			break;
+		}
+		size_t copied = 0;
+		for (const auto &item : items) {
+			// new owners take client writes once placement moved off this node, and those win over an older copy;
+			// a write that reached this node after the drain began is at least as new, so it replaces theirs
+			uint16_t flags = item.second.seq > drain_start ? 0 : MESSAGE_FLAG_KEEP_EXISTING;
+			if (hand_off(item.first, item.second, flags)) {
+				++copied;
+			}
+		}
+		log_line("INFO", "Drain pass " + std::to_string(pass + 1) + " handed off " + std::to_string(copied) + " of " + std::to_string(items.size()) + " keys");
+		if (copied == items.size()) {
+			handed_through = pass_seq;
+		} else {
+			std::this_thread::sleep_for(DRAIN_RETRY);
+		}
+	}
+	if (!drained) {
+		log_line("ERROR", "Drain did not complete; staying in the table");
+		draining = false;
+		return;
+	}
+	NodeAddress manager_addr{DEFAULT_MANAGER_HOST, DEFAULT_MANAGER_PORT};
+	bool removed = false;
+	for (int attempt = 0; attempt < MAX_DRAIN_PASSES && !removed; ++attempt) {
+		int fd = connect_to_host(manager_addr);
+		if (fd >= 0) {
+			MessageType type;
+			std::string reply;
+			removed = send_typed<MessageType::DRAIN_DONE>(fd, {storage_id}) && recv_message(fd, type, reply) && type == MessageType::DECOMMISSION_ACK;
+			close(fd);
+		}
+		if (!removed) {
+			std::this_thread::sleep_for(DRAIN_RETRY);
+		}
+	}
+	if (!removed) {
+		log_line("ERROR", "Manager did not confirm the drain; staying up");
+		{
+			std::lock_guard<std::mutex> guard(store_mutex);
+			writes_sealed = false;
+		}
+		draining = false;
+		return;
+	}
+	running = false;
+	log_line("INFO", "Handoff complete, " + storage_id + " left the table; exiting after grace period");
+	std::this_thread::sleep_for(RETIRE_GRACE);
+	if (gossip) {
+		gossip->stop();
+	}
+	log_line("INFO", "Storage " + storage_id + " decommissioned");
+	_exit(0);
+}
+
 // This reads a key locally.
 void GTStoreStorage::handle_get(int client_fd, const std::string &payload) {
-	if (!key_valid(payload)) {
+	KeyRequest request;
+	if (!decode_message<MessageType::CLIENT_GET>(payload, request) || !key_valid(request.key)) {
 		send_message(client_fd, MessageType::ERROR, "bad key");
 		return;
 	}
-	auto it = kv_store.find(payload);
-	if (it == kv_store.end()) {
-		log_line("WARN", "GET miss key=" + payload + " on " + storage_id);
+	std::string key(request.key);
+	uint64_t epoch = 0;
+	if (!owns_key(key, epoch, true)) {
+		log_line("WARN", "GET rejected key=" + key + " not owned by " + storage_id + " at epoch " + std::to_string(epoch));
+		send_typed<MessageType::WRONG_OWNER>(client_fd, {epoch});
+		return;
+	}
+	++window_requests;
+	hot_keys->record(ring_hash(key));
+	StoredValue value;
+	bool found = false;
+	{
+		std::lock_guard<std::mutex> guard(store_mutex);
+		auto it = kv_store.find(key);
+		found = it != kv_store.end();
+		if (found) {
+			value = it->second;
+		}
+	}
+	if (!found) {
+		log_line("WARN", "GET miss key=" + key + " on " + storage_id);
 		send_message(client_fd, MessageType::ERROR, "missing");
 		return;
 	}
-	log_line("INFO", "GET hit key=" + payload + " value=" + it->second + " on " + storage_id);
-	send_message(client_fd, MessageType::GET_OK, it->second);
+	if (value.chunks) {
+		send_message(client_fd, MessageType::STREAMED_VALUE, "");
+		return;
+	}
+	log_line("INFO", "GET hit key=" + key + " value=" + show_value(value) + " on " + storage_id);
+	send_message(client_fd, MessageType::GET_OK, value.bytes, value.flags);
+}
+
+// This serves this node's copy of the routing table so clients need not all ask the manager.
+// Without a change history it answers a sync with "unchanged" or the full table.
+void GTStoreStorage::handle_table_request(int client_fd, MessageType type, const std::string &payload) {
+	std::string reply;
+	MessageType reply_type = MessageType::TABLE_PUSH;
+	{
+		std::lock_guard<std::mutex> guard(table_mutex);
+		uint64_t since = 0;
+		EpochMessage request{0};
+		if (type == MessageType::TABLE_SYNC && decode_message<MessageType::TABLE_SYNC>(payload, request)) {
+			since = request.epoch;
+		}
+		if (table.nodes.empty()) {
+			reply_type = MessageType::ERROR;
+			reply = "no table";
+		} else if (since != 0 && since == table.epoch) {
+			reply_type = MessageType::TABLE_UNCHANGED;
+			reply = encode_message<MessageType::TABLE_UNCHANGED>({table.epoch});
+		} else if (since > table.epoch) {
+			// the client is ahead of us; let it go to the manager
+			reply_type = MessageType::ERROR;
+			reply = "behind";
+		} else {
+			reply = build_table_payload(table);
+		}
+	}
+	send_message(client_fd, reply_type, reply);
 }
 
 // This accepts client requests.
@@ -116,14 +680,23 @@ void GTStoreStorage::serve_clients() {
 		std::thread([this, client_fd]() {
 			MessageType type;
 			std::string payload;
-			if (!recv_message(client_fd, type, payload)) {
+			uint16_t flags = 0;
+			if (!recv_message(client_fd, type, payload, flags)) {
 				close(client_fd);
 				return;
 			}
 			if (type == MessageType::CLIENT_PUT) {
-				handle_put(client_fd, payload);
+				handle_put(client_fd, payload, flags);
 			} else if (type == MessageType::CLIENT_GET) {
 				handle_get(client_fd, payload);
+			} else if (type == MessageType::REPL_PUT) {
+				handle_replica_put(client_fd, payload, flags);
+			} else if (type == MessageType::STREAM_PUT || type == MessageType::STREAM_REPL_PUT) {
+				handle_stream_put(client_fd, payload, flags, type == MessageType::STREAM_REPL_PUT);
+			} else if (type == MessageType::STREAM_GET) {
+				handle_stream_get(client_fd, payload);
+			} else if (type == MessageType::CLIENT_HELLO || type == MessageType::TABLE_SYNC) {
+				handle_table_request(client_fd, type, payload);
 			} else {
 				send_message(client_fd, MessageType::ERROR, "unknown");
 			}
@@ -146,10 +719,33 @@ void GTStoreStorage::init() {
 	} else {
 		storage_id = "node" + std::to_string(::getpid());
 	}
+	capacity_weight = 1;
+	const char *weight_env = std::getenv("GTSTORE_NODE_WEIGHT");
+	if (weight_env) {
+		int parsed = std::atoi(weight_env);
+		if (parsed >= 1) {
+			capacity_weight = static_cast<uint32_t>(parsed);
+		}
+	}
+	uint32_t hot_threshold = DEFAULT_HOT_THRESHOLD;
+	const char *hot_env = std::getenv("GTSTORE_HOT_THRESHOLD");
+	if (hot_env) {
+		int parsed = std::atoi(hot_env);
+		if (parsed >= 1) {
+			hot_threshold = static_cast<uint32_t>(parsed);
+		}
+	}
+	hot_keys.reset(new HotKeyTracker(HOT_SKETCH_WIDTH, HOT_SKETCH_DEPTH, hot_threshold, MAX_HOT_KEYS));
+	window_requests = 0;
+	draining = false;
+	write_seq = 0;
+	writes_sealed = false;
+	handoff_epoch = 0;
 	replication_factor = 1;
+	table = TableSnapshot{};
 	running = true;
 	setup_logging(COMPONENT_PREFIX + storage_id);
-	log_line("INFO", "Storage label set to " + storage_id);
+	log_line("INFO", "Storage label set to " + storage_id + " with capacity weight " + std::to_string(capacity_weight));
 	NodeAddress addr{"127.0.0.1", listen_port};
 	listen_fd = create_listen_socket(addr, BACKLOG);
 	if (listen_fd < 0) {
@@ -158,17 +754,27 @@ void GTStoreStorage::init() {
 	}
 	log_line("INFO", "Listening on " + addr.host + ":" + std::to_string(addr.port));
 	register_with_manager();
+	const char *gossip_env = std::getenv("GTSTORE_GOSSIP");
+	if (!gossip_env || std::string(gossip_env) != "0") {
+		gossip = GossipMembership::start(storage_id, addr);
+		if (gossip) {
+			std::lock_guard<std::mutex> guard(table_mutex);
+			gossip->observe_table(table.nodes);
+		}
+	}
+	NodeAddress manager_addr{DEFAULT_MANAGER_HOST, DEFAULT_MANAGER_PORT};
+	subscription = TableSubscription::start(manager_addr, [this](uint64_t epoch) { sync_table_from_manager(epoch); });
 	heartbeat_thread = std::thread(&GTStoreStorage::heartbeat_loop, this);
 	heartbeat_thread.detach();
 	serve_clients();
 }
 
-// This prints every key/value in this storage.
+// This prints every key/value in this storage. Caller holds store_mutex.
 void GTStoreStorage::log_current_store() {
 	std::ostringstream out;
 	out << "Store snapshot on " << storage_id << ":";
 	for (const auto &entry : kv_store) {
-		out << " [" << entry.first << "=" << entry.second << "]";
+		out << " [" << entry.first << "=" << show_value(entry.second) << "]";
 	}
 	log_line("INFO", out.str());
 }
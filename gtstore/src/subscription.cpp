@@ -0,0 +1,103 @@
+#include "subscription.hpp"
+#include "messages.hpp"
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace {
+const auto RECONNECT_DELAY = std::chrono::seconds(1);
+}
+
+// This starts the subscriber thread.
+std::shared_ptr<TableSubscription> TableSubscription::start(const NodeAddress &manager, EpochCallback on_epoch) {
+    std::shared_ptr<TableSubscription> self(new TableSubscription());
+    self->manager = manager;
+    self->on_epoch = on_epoch;
+    // the thread owns a reference, so the state outlives whoever called stop()
+    self->worker = std::thread(&TableSubscription::run, self);
+    return self;
+}
+
+// This returns the newest epoch pushed by the manager.
+uint64_t TableSubscription::announced_epoch() const {
+    return latest_epoch.load();
+}
+
+// This reports whether the channel is currently open.
+bool TableSubscription::connected() const {
+    return is_connected.load();
+}
+
+// This stops the thread: shutdown wakes a blocked recv, the thread closes the fd on its way out, and we join it.
+void TableSubscription::stop() {
+    running = false;
+    {
+        std::lock_guard<std::mutex> guard(fd_mutex);
+        if (channel_fd >= 0) {
+            shutdown(channel_fd, SHUT_RDWR);
+        }
+    }
+    if (!worker.joinable()) {
+        return;
+    }
+    // an epoch callback that stops its own subscription cannot wait for itself
+    if (worker.get_id() == std::this_thread::get_id()) {
+        worker.detach();
+    } else {
+        worker.join();
+    }
+}
+
+// This keeps a subscription open and records pushed epochs.
+void TableSubscription::run(std::shared_ptr<TableSubscription> self) {
+    while (self->running) {
+        int fd = connect_to_host(self->manager);
+        if (fd < 0) {
+            std::this_thread::sleep_for(RECONNECT_DELAY);
+            continue;
+        }
+        if (!send_message(fd, MessageType::TABLE_SUBSCRIBE, "")) {
+            close(fd);
+            std::this_thread::sleep_for(RECONNECT_DELAY);
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> guard(self->fd_mutex);
+            self->channel_fd = fd;
+        }
+        // a stop() that ran before the fd was published had nothing to shut down
+        if (!self->running) {
+            std::lock_guard<std::mutex> guard(self->fd_mutex);
+            self->channel_fd = -1;
+            close(fd);
+            break;
+        }
+        MessageType type;
+        std::string payload;
+        while (self->running && recv_message(fd, type, payload)) {
+            if (type != MessageType::TABLE_EPOCH) {
+                continue;
+            }
+            EpochMessage pushed{0};
+            if (!decode_message<MessageType::TABLE_EPOCH>(payload, pushed)) {
+                continue;
+            }
+            uint64_t epoch = pushed.epoch;
+            self->latest_epoch = epoch;
+            self->is_connected = true;
+            if (self->on_epoch) {
+                self->on_epoch(epoch);
+            }
+        }
+        self->is_connected = false;
+        {
+            std::lock_guard<std::mutex> guard(self->fd_mutex);
+            self->channel_fd = -1;
+            close(fd);
+        }
+        if (self->running) {
+            std::this_thread::sleep_for(RECONNECT_DELAY);
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef GTSTORE_SUBSCRIPTION_HPP
+#define GTSTORE_SUBSCRIPTION_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "net_common.hpp"
+
+// NEWLY ADDED: long-lived TABLE_SUBSCRIBE channel to the manager.
+// A background thread keeps the connection open, reconnects on failure and
+// records every epoch the manager pushes, so callers learn about membership
+// changes without first failing a request.
+class TableSubscription {
+public:
+    typedef std::function<void(uint64_t)> EpochCallback;
+
+    // This starts the subscriber thread; on_epoch may be empty.
+    static std::shared_ptr<TableSubscription> start(const NodeAddress &manager, EpochCallback on_epoch);
+
+    // This returns the newest epoch pushed by the manager, or 0 before the first push.
+    uint64_t announced_epoch() const;
+
+    // This reports whether the channel is currently open.
+    bool connected() const;
+
+    // This wakes the thread, waits for it to exit and only then lets the channel fd go.
+    void stop();
+
+private:
+    NodeAddress manager;
+    EpochCallback on_epoch;
+    std::atomic<uint64_t> latest_epoch{0};
+    std::atomic<bool> running{true};
+    std::atomic<bool> is_connected{false};
+    // the fd is only closed by the thread, under fd_mutex, so stop() never touches a reused number
+    std::mutex fd_mutex;
+    int channel_fd = -1;
+    std::thread worker;
+
+    static void run(std::shared_ptr<TableSubscription> self);
+};
+
+#endif
@@ -1,8 +1,16 @@
+#include "crc32c.hpp"
 #include "gtstore.hpp"
+#include "hash.hpp"
+#include "lz.hpp"
+#include "messages.hpp"
+#include "routing.hpp"
+#include "utils.hpp"
 
+#include <algorithm>
 #include <chrono>
 #include <cstdlib>
 #include <fstream>
+#include <functional>
 #include <random>
 #include <sstream>
 #include <string>
@@ -20,6 +28,8 @@ const vector<pair<string, string>> FAILURE_KEYS = {
 	{"key5", "value5"},
 	{"key6", "value6"}
 };
+// matches the manager's default tokens per unit of capacity weight
+const size_t SIM_TOKENS_PER_NODE = 8;
 
 // This appends a performance line when requested.
 void append_perf_line(const std::string &line) {
@@ -36,7 +46,7 @@ void append_perf_line(const std::string &line) {
 // This prints a simple usage hint.
 void print_usage(const char *prog) {
 	cout << "Usage: " << prog << " <test> <client_id> [extra]\n";
-	cout << "Tests: single_set_get, basic_trace, failure_load, failure_verify, multi_failure_load, multi_failure_verify, throughput, load_balance\n";
+	cout << "Tests: single_set_get, basic_trace, failure_load, failure_verify, multi_failure_load, multi_failure_verify, throughput, load_balance, hash_bench, placement_compare, hot_reads, skewed_reads, decommission, maintenance_traffic, value_roundtrip, table_codec_bench, compress_bench, checksum_bench, stream_roundtrip\n";
 }
 }
 
@@ -213,7 +223,12 @@ void load_balance_driver(int client_id, int inserts) {
 		StorageNodeInfo owner = client.debug_pick_for_test(key, 0);
 		counts[owner.node_id] += 1;
 	}
+	std::unordered_map<std::string, bool> reported;
 	for (const auto &node : table) {
+		if (reported[node.node_id]) {
+			continue;
+		}
+		reported[node.node_id] = true;
 		std::ostringstream line;
 		line << node.node_id << "," << counts[node.node_id];
 		append_perf_line(line.str());
@@ -222,6 +237,493 @@ void load_balance_driver(int client_id, int inserts) {
 	client.finalize();
 }
 
+// This times one hash function over the key set and reports ns per hash.
+template <typename Hasher>
+void time_hash(const string &name, const vector<string> &keys, int rounds, Hasher hasher) {
+	uint64_t sink = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; ++r) {
+		for (const auto &key : keys) {
+			sink ^= hasher(key);
+		}
+	}
+	auto finish = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(finish - start).count();
+	double hashes = static_cast<double>(rounds) * static_cast<double>(keys.size());
+	std::ostringstream line;
+	line << name << "," << static_cast<long long>(hashes) << "," << seconds << ","
+	     << (hashes > 0 ? seconds * 1e9 / hashes : 0.0) << "," << (sink & 0xff);
+	append_perf_line(line.str());
+}
+
+// This times std::hash against the ring hash on short keys.
+void hash_bench_driver(int client_id, int rounds) {
+	cout << "Running hash benchmark with " << rounds << " rounds.\n";
+	vector<string> keys;
+	std::mt19937 rng(client_id);
+	std::uniform_int_distribution<int> length(1, MAX_KEY_BYTE_PER_REQUEST);
+	std::uniform_int_distribution<int> letter('a', 'z');
+	for (int i = 0; i < 4096; ++i) {
+		string key(static_cast<size_t>(length(rng)), 'a');
+		for (auto &c : key) {
+			c = static_cast<char>(letter(rng));
+		}
+		keys.push_back(key);
+	}
+	std::hash<std::string> std_hasher;
+	time_hash("std_hash", keys, rounds, [&](const string &key) { return static_cast<uint64_t>(std_hasher(key)); });
+	time_hash("ring_hash", keys, rounds, [](const string &key) { return ring_hash(key); });
+}
+
+// This builds a synthetic table of node_count equal nodes, tokenised like the manager does.
+TableSnapshot synthetic_table(int node_count, PlacementMode mode) {
+	TableSnapshot table;
+	table.replication_factor = 3;
+	table.epoch = 1;
+	table.placement = mode;
+	for (int i = 1; i <= node_count; ++i) {
+		StorageNodeInfo node;
+		node.node_id = "sim" + to_string(i);
+		node.address = NodeAddress{"127.0.0.1", static_cast<uint16_t>(7000 + i)};
+		node.weight = 1;
+		node.bucket = static_cast<uint32_t>(i - 1);
+		for (size_t t = 0; t < SIM_TOKENS_PER_NODE; ++t) {
+			node.token = node_token(node.node_id, node.address, t);
+			table.nodes.push_back(node);
+		}
+	}
+	return table;
+}
+
+// This times serializing and parsing a routing table of about entry_count ring entries.
+void table_codec_bench_driver(int entry_count, int rounds) {
+	cout << "Timing table payload build/parse at " << entry_count << " entries over " << rounds << " rounds.\n";
+	TableSnapshot table = synthetic_table(std::max(1, entry_count / static_cast<int>(SIM_TOKENS_PER_NODE)), PlacementMode::RING);
+	for (uint64_t i = 0; i < 16; ++i) {
+		table.hot_keys.push_back(ring_hash("hot" + to_string(i)));
+	}
+	uint64_t sink = 0;
+	string payload;
+	auto build_start = std::chrono::steady_clock::now();
+	for (int round = 0; round < rounds; ++round) {
+		table.epoch = static_cast<uint64_t>(round + 1);
+		payload = gtstore_utils::build_table_payload(table);
+		sink += payload.size();
+	}
+	auto build_end = std::chrono::steady_clock::now();
+	for (int round = 0; round < rounds; ++round) {
+		TableSnapshot parsed = gtstore_utils::parse_table_payload(payload);
+		sink += parsed.nodes.size() + parsed.nodes.back().token;
+	}
+	auto parse_end = std::chrono::steady_clock::now();
+	TableSnapshot check = gtstore_utils::parse_table_payload(payload);
+	bool same = check.epoch == table.epoch && check.nodes.size() == table.nodes.size() && check.hot_keys == table.hot_keys;
+	for (size_t i = 0; same && i < check.nodes.size(); ++i) {
+		same = check.nodes[i].node_id == table.nodes[i].node_id && check.nodes[i].token == table.nodes[i].token &&
+		       check.nodes[i].address.host == table.nodes[i].address.host && check.nodes[i].address.port == table.nodes[i].address.port;
+	}
+	if (!same) {
+		cout << "Parsed table does not match the original\n";
+	}
+	double build_us = std::chrono::duration<double, std::micro>(build_end - build_start).count() / rounds;
+	double parse_us = std::chrono::duration<double, std::micro>(parse_end - build_end).count() / rounds;
+	std::ostringstream line;
+	line << table.nodes.size() << "," << payload.size() << "," << build_us << "," << parse_us << "," << sink;
+	append_perf_line(line.str());
+}
+
+// This returns the primary node id for every key hash.
+vector<string> primaries(const TableSnapshot &table, const vector<uint64_t> &hashes) {
+	RoutingIndex index;
+	index.rebuild(table);
+	vector<string> owners;
+	owners.reserve(hashes.size());
+	for (uint64_t h : hashes) {
+		owners.push_back(index.replica_for(h, 0)->node_id);
+	}
+	return owners;
+}
+
+// This returns the fraction of keys whose primary differs.
+double moved_fraction(const vector<string> &before, const vector<string> &after) {
+	size_t moved = 0;
+	for (size_t i = 0; i < before.size(); ++i) {
+		if (before[i] != after[i]) {
+			++moved;
+		}
+	}
+	return before.empty() ? 0.0 : static_cast<double>(moved) / static_cast<double>(before.size());
+}
+
+// This compares balance, lookup cost and data movement across placement modes.
+void placement_compare_driver(int node_count, int key_count) {
+	cout << "Comparing placement modes with " << node_count << " nodes and " << key_count << " keys.\n";
+	vector<uint64_t> hashes;
+	for (int i = 0; i < key_count; ++i) {
+		hashes.push_back(ring_hash("cmp_key_" + to_string(i)));
+	}
+	const PlacementMode modes[] = {PlacementMode::RING, PlacementMode::RENDEZVOUS, PlacementMode::JUMP};
+	for (PlacementMode mode : modes) {
+		TableSnapshot base = synthetic_table(node_count, mode);
+		RoutingIndex index;
+		index.rebuild(base);
+		uint64_t sink = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (uint64_t h : hashes) {
+			sink += index.replica_for(h, 0)->token;
+		}
+		auto finish = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration_cast<std::chrono::duration<double>>(finish - start).count();
+
+		vector<string> before = primaries(base, hashes);
+		std::unordered_map<std::string, size_t> counts;
+		size_t max_count = 0;
+		for (const auto &owner : before) {
+			max_count = std::max(max_count, ++counts[owner]);
+		}
+		double mean = static_cast<double>(key_count) / static_cast<double>(node_count);
+		vector<string> joined = primaries(synthetic_table(node_count + 1, mode), hashes);
+		// a node from the middle leaves, so jump placement cannot get away with trimming its last bucket
+		TableSnapshot shrunk = base;
+		string leaving = "sim" + to_string(node_count / 2 + 1);
+		shrunk.nodes.erase(std::remove_if(shrunk.nodes.begin(), shrunk.nodes.end(), [&](const StorageNodeInfo &node) {
+			return node.node_id == leaving;
+		}), shrunk.nodes.end());
+		vector<string> left = primaries(shrunk, hashes);
+
+		std::ostringstream line;
+		line << gtstore_utils::placement_name(mode) << "," << node_count << "," << key_count << ","
+		     << (mean > 0 ? static_cast<double>(max_count) / mean : 0.0) << ","
+		     << (key_count > 0 ? seconds * 1e9 / key_count : 0.0) << ","
+		     << moved_fraction(before, joined) << "," << moved_fraction(before, left) << "," << (sink & 0x1);
+		append_perf_line(line.str());
+	}
+}
+
+// This hammers one key with reads so storage nodes flag it as hot.
+void hot_reads_driver(int client_id, int reads) {
+	cout << "Reading one hot key " << reads << " times.\n";
+	GTStoreClient client;
+	client.init(client_id);
+	val_t value;
+	value.push_back("hot_value");
+	client.put("hot_key", value);
+	for (int i = 0; i < reads; ++i) {
+		client.get("hot_key");
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+	client.finalize();
+}
+
+// This reads a skewed key mix in rounds and reports how evenly primaries share the reads.
+void skewed_reads_driver(int client_id, int rounds, const string &label) {
+	cout << "Running " << rounds << " rounds of skewed reads.\n";
+	GTStoreClient client;
+	client.init(client_id);
+	const int key_count = 1000;
+	const int reads_per_round = 400;
+	for (int i = 0; i < key_count; ++i) {
+		val_t value;
+		value.push_back("skew_val_" + to_string(i));
+		client.put("skew_key_" + to_string(i), value);
+	}
+	std::mt19937 rng(client_id);
+	std::uniform_real_distribution<double> unit(0.0, 1.0);
+	for (int round = 0; round < rounds; ++round) {
+		std::unordered_map<std::string, size_t> counts;
+		size_t max_count = 0;
+		for (int i = 0; i < reads_per_round; ++i) {
+			// squaring a uniform draw piles reads onto the low-numbered keys
+			double u = unit(rng);
+			string key = "skew_key_" + to_string(static_cast<int>(key_count * u * u));
+			client.get(key);
+			max_count = std::max(max_count, ++counts[client.debug_pick_for_test(key, 0).node_id]);
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+		}
+		std::unordered_map<std::string, bool> distinct;
+		for (const auto &node : client.current_table_snapshot()) {
+			distinct[node.node_id] = true;
+		}
+		double mean = distinct.empty() ? 0.0 : static_cast<double>(reads_per_round) / static_cast<double>(distinct.size());
+		std::ostringstream line;
+		line << label << "," << round << "," << reads_per_round << "," << (mean > 0 ? static_cast<double>(max_count) / mean : 0.0);
+		append_perf_line(line.str());
+	}
+	client.finalize();
+}
+
+// This stores values the old comma join could not carry and checks they come back unchanged.
+void value_roundtrip(int client_id) {
+	cout << "Checking value round trips with client " << client_id << ".\n";
+	GTStoreClient client;
+	client.init(client_id);
+	string text;
+	while (text.size() < 900) {
+		text += "status=ok region=us-east-1 tier=gold ";
+	}
+	vector<val_t> cases = {
+		{"a,b", "c"},
+		{"", "middle", ""},
+		{},
+		{string("nul\0byte", 8), "|pipe|"},
+		// large and repetitive, so it goes out compressed
+		{text.substr(0, 900)}
+	};
+	size_t failures = 0;
+	for (size_t i = 0; i < cases.size(); ++i) {
+		string key = "roundtrip_" + to_string(i);
+		bool stored = client.put(key, cases[i]);
+		val_t got = client.get(key);
+		bool same = stored && got == cases[i];
+		failures += same ? 0 : 1;
+		cout << "Round trip " << key << " (" << cases[i].size() << " elements): " << (same ? "ok" : "MISMATCH") << "\n";
+	}
+	cout << "Round trips failed: " << failures << "\n";
+	client.finalize();
+}
+
+// This measures the lz codec on repetitive text and on random bytes, value-sized.
+void compress_bench_driver(int client_id, int rounds) {
+	cout << "Running compression benchmark with " << rounds << " rounds.\n";
+	std::mt19937 rng(client_id);
+	string text;
+	const char *words[] = {"status=ok ", "region=us-east-1 ", "tier=gold ", "user=", "latency_ms=12 ", "path=/api/v1/items "};
+	while (text.size() < 900) {
+		text += words[rng() % 6];
+		text += to_string(rng() % 100) + " ";
+	}
+	text.resize(900);
+	string noise(900, ' ');
+	for (auto &c : noise) {
+		c = static_cast<char>(rng());
+	}
+	vector<pair<string, string>> inputs = {{"text", text}, {"random", noise}};
+	for (const auto &input : inputs) {
+		string block;
+		uint64_t sink = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < rounds; ++i) {
+			block = lz_compress(input.second);
+			sink += block.size();
+		}
+		auto middle = std::chrono::steady_clock::now();
+		string expanded;
+		bool ok = true;
+		for (int i = 0; i < rounds; ++i) {
+			ok = lz_decompress(block, expanded, input.second.size()) && ok;
+			sink += expanded.size();
+		}
+		auto end = std::chrono::steady_clock::now();
+		ok = ok && expanded == input.second;
+		double mb = static_cast<double>(input.second.size()) * rounds / 1e6;
+		std::ostringstream line;
+		line << input.first << "," << input.second.size() << "," << block.size() << ","
+		     << static_cast<double>(block.size()) / input.second.size() << ","
+		     << mb / std::chrono::duration<double>(middle - start).count() << ","
+		     << mb / std::chrono::duration<double>(end - middle).count() << "," << (ok ? "ok" : "MISMATCH") << "," << sink;
+		append_perf_line(line.str());
+	}
+}
+
+// This measures CRC32C throughput on the hardware and software paths, then checks that a frame
+// with one flipped payload byte is refused.
+void checksum_bench_driver(int client_id, int rounds) {
+	cout << "Running checksum benchmark with " << rounds << " rounds (hardware path " << (crc32c_hardware() ? "on" : "off") << ").\n";
+	cout << "crc32c(\"123456789\") = " << std::hex << crc32c("123456789", 9) << std::dec << " (expect e3069283)\n";
+	std::mt19937 rng(client_id);
+	for (size_t size : {size_t(64), size_t(1024), size_t(65536)}) {
+		string data(size, ' ');
+		for (auto &c : data) {
+			c = static_cast<char>(rng());
+		}
+		size_t repeat = std::max<size_t>(1, static_cast<size_t>(rounds) * 1024 / size);
+		uint32_t hardware = 0;
+		uint32_t software = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < repeat; ++i) {
+			hardware ^= crc32c_extend(static_cast<uint32_t>(i), data.data(), data.size());
+		}
+		auto middle = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < repeat; ++i) {
+			software ^= crc32c_software(static_cast<uint32_t>(i), data.data(), data.size());
+		}
+		auto end = std::chrono::steady_clock::now();
+		double mb = static_cast<double>(size) * repeat / 1e6;
+		std::ostringstream line;
+		line << size << "," << mb / std::chrono::duration<double>(middle - start).count() << ","
+		     << mb / std::chrono::duration<double>(end - middle).count() << "," << (hardware == software ? "ok" : "MISMATCH");
+		append_perf_line(line.str());
+	}
+
+	// capture one framed message, flip a payload byte, and feed it back through recv_message
+	int pair[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) < 0) {
+		cout << "socketpair failed\n";
+		return;
+	}
+	const string probe = "checksum_probe";
+	MessageType type;
+	string payload;
+	bool clean = send_message(pair[1], MessageType::CLIENT_GET, probe) && recv_message(pair[0], type, payload) && payload == probe;
+	bool refused = false;
+	if (send_message(pair[1], MessageType::CLIENT_GET, probe)) {
+		string frame(sizeof(MessageHeader) + probe.size() + (frame_checksums_enabled() ? 4 : 0), '\0');
+		bool captured = recv_all(pair[0], &frame[0], frame.size());
+		frame[sizeof(MessageHeader)] ^= 0x01;
+		refused = captured && send_all(pair[1], frame.data(), frame.size()) && !recv_message(pair[0], type, payload);
+	}
+	close(pair[0]);
+	close(pair[1]);
+	cout << "Clean frame accepted: " << (clean ? "yes" : "no") << "\n";
+	cout << "Corrupted frame refused: " << (refused ? "yes" : (frame_checksums_enabled() ? "no" : "no (checksums off)")) << "\n";
+}
+
+// This writes size bytes of seeded pseudo-random data to a file in 64 KB pieces.
+bool write_stream_source(const string &path, size_t size, uint32_t seed) {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	std::mt19937 rng(seed);
+	string piece(STREAM_CHUNK_BYTES, ' ');
+	for (size_t written = 0; written < size && out; written += piece.size()) {
+		piece.resize(std::min<size_t>(STREAM_CHUNK_BYTES, size - written));
+		for (auto &c : piece) {
+			c = static_cast<char>('a' + rng() % 26);
+		}
+		out.write(piece.data(), static_cast<std::streamsize>(piece.size()));
+	}
+	return static_cast<bool>(out);
+}
+
+// This compares two files piece by piece.
+bool same_file_contents(const string &left, const string &right) {
+	std::ifstream a(left, std::ios::binary);
+	std::ifstream b(right, std::ios::binary);
+	string piece_a(STREAM_CHUNK_BYTES, ' ');
+	string piece_b(STREAM_CHUNK_BYTES, ' ');
+	while (a && b) {
+		a.read(&piece_a[0], static_cast<std::streamsize>(piece_a.size()));
+		b.read(&piece_b[0], static_cast<std::streamsize>(piece_b.size()));
+		if (a.gcount() != b.gcount() || piece_a.compare(0, static_cast<size_t>(a.gcount()), piece_b, 0, static_cast<size_t>(b.gcount())) != 0) {
+			return false;
+		}
+	}
+	return a.eof() && b.eof();
+}
+
+// This puts a file-backed value with put_stream and reads it back into another file with get_stream, so neither
+// side holds the whole value in memory, then times the same bytes stored by hand as 900-byte keyed shards.
+void stream_roundtrip_driver(int client_id, size_t megabytes, bool with_shards) {
+	cout << "Running streamed round trip of " << megabytes << " MB.\n";
+	GTStoreClient client;
+	client.init(client_id);
+	size_t size = megabytes * 1024 * 1024;
+	string source_path = "/tmp/gtstore_stream_" + to_string(client_id) + ".in";
+	string sink_path = "/tmp/gtstore_stream_" + to_string(client_id) + ".out";
+	if (!write_stream_source(source_path, size, static_cast<uint32_t>(client_id))) {
+		cout << "Could not write " << source_path << "\n";
+		client.finalize();
+		return;
+	}
+	string key = "blob_" + to_string(megabytes) + "mb";
+	auto start = std::chrono::steady_clock::now();
+	bool stored = false;
+	{
+		std::ifstream in(source_path, std::ios::binary);
+		stored = client.put_stream(key, in);
+	}
+	auto middle = std::chrono::steady_clock::now();
+	bool fetched = false;
+	{
+		std::ofstream out(sink_path, std::ios::binary | std::ios::trunc);
+		fetched = client.get_stream(key, out);
+	}
+	auto end = std::chrono::steady_clock::now();
+	bool same = stored && fetched && same_file_contents(source_path, sink_path);
+	cout << "Streamed " << key << ": " << (same ? "ok" : "MISMATCH") << "\n";
+	double mb = static_cast<double>(size) / 1e6;
+	std::ostringstream line;
+	line << "stream," << size << "," << mb / std::chrono::duration<double>(middle - start).count() << ","
+	     << mb / std::chrono::duration<double>(end - middle).count() << "," << (same ? "ok" : "MISMATCH");
+	append_perf_line(line.str());
+
+	if (with_shards) {
+		// what applications did before: one value per 900-byte slice under numbered keys
+		const size_t shard_bytes = 900;
+		std::ifstream in(source_path, std::ios::binary);
+		string piece(shard_bytes, ' ');
+		size_t shards = 0;
+		bool shards_ok = true;
+		auto shard_start = std::chrono::steady_clock::now();
+		while (in.read(&piece[0], static_cast<std::streamsize>(piece.size())) || in.gcount() > 0) {
+			piece.resize(static_cast<size_t>(in.gcount()));
+			shards_ok = client.put("s" + to_string(megabytes) + "_" + to_string(shards++), val_t{piece}) && shards_ok;
+		}
+		auto shard_middle = std::chrono::steady_clock::now();
+		std::ofstream out(sink_path, std::ios::binary | std::ios::trunc);
+		for (size_t i = 0; i < shards; ++i) {
+			val_t got = client.get("s" + to_string(megabytes) + "_" + to_string(i));
+			shards_ok = got.size() == 1 && shards_ok;
+			if (!got.empty()) {
+				out.write(got[0].data(), static_cast<std::streamsize>(got[0].size()));
+			}
+		}
+		out.close();
+		auto shard_end = std::chrono::steady_clock::now();
+		shards_ok = shards_ok && same_file_contents(source_path, sink_path);
+		std::ostringstream shard_line;
+		shard_line << "sharded," << size << "," << mb / std::chrono::duration<double>(shard_middle - shard_start).count() << ","
+		           << mb / std::chrono::duration<double>(shard_end - shard_middle).count() << "," << (shards_ok ? "ok" : "MISMATCH");
+		append_perf_line(shard_line.str());
+	}
+	std::remove(source_path.c_str());
+	std::remove(sink_path.c_str());
+	client.finalize();
+}
+
+// This asks the manager to drain and remove one storage node.
+void decommission_driver(const string &node_id) {
+	NodeAddress manager_addr{DEFAULT_MANAGER_HOST, DEFAULT_MANAGER_PORT};
+	int fd = connect_to_host(manager_addr);
+	if (fd < 0) {
+		cout << "Could not reach manager\n";
+		return;
+	}
+	MessageType type;
+	string reply;
+	bool answered = send_typed<MessageType::DECOMMISSION>(fd, {node_id}) && recv_message(fd, type, reply);
+	close(fd);
+	if (answered && type == MessageType::DECOMMISSION_ACK) {
+		cout << "Decommission of " << node_id << ": " << reply << "\n";
+	} else {
+		cout << "Decommission of " << node_id << " refused: " << (answered ? reply : string("no reply")) << "\n";
+	}
+}
+
+// This keeps rewriting and reading back a small key set for a while and counts operations that failed
+// or read a stale value, so node maintenance can be judged by what clients saw.
+void maintenance_traffic_driver(int client_id, int seconds, const string &label) {
+	cout << "Running read/write traffic for " << seconds << " seconds.\n";
+	GTStoreClient client;
+	client.init(client_id);
+	const int key_count = 50;
+	size_t ops = 0;
+	size_t errors = 0;
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+	for (int round = 0; std::chrono::steady_clock::now() < deadline; ++round) {
+		for (int i = 0; i < key_count; ++i) {
+			string key = "maint_key_" + to_string(i);
+			string expected = "v" + to_string(round);
+			val_t value;
+			value.push_back(expected);
+			errors += client.put(key, value) ? 0 : 1;
+			val_t got = client.get(key);
+			errors += (!got.empty() && got[0] == expected) ? 0 : 1;
+			ops += 2;
+		}
+	}
+	client.finalize();
+	append_perf_line(label + "," + to_string(ops) + "," + to_string(errors));
+}
+
 int main(int argc, char **argv) {
 	if (argc < 3) {
 		print_usage(argv[0]);
@@ -247,6 +749,46 @@ int main(int argc, char **argv) {
 	} else if (test == "load_balance") {
 		int inserts = (argc >= 4) ? atoi(argv[3]) : 100000;
 		load_balance_driver(client_id, inserts);
+	} else if (test == "hash_bench") {
+		int rounds = (argc >= 4) ? atoi(argv[3]) : 2000;
+		hash_bench_driver(client_id, rounds);
+	} else if (test == "placement_compare") {
+		int node_count = (argc >= 4) ? atoi(argv[3]) : 7;
+		int key_count = (argc >= 5) ? atoi(argv[4]) : 100000;
+		placement_compare_driver(std::max(1, node_count), key_count);
+	} else if (test == "hot_reads") {
+		int reads = (argc >= 4) ? atoi(argv[3]) : 1000;
+		hot_reads_driver(client_id, reads);
+	} else if (test == "skewed_reads") {
+		int rounds = (argc >= 4) ? atoi(argv[3]) : 8;
+		string label = (argc >= 5) ? string(argv[4]) : "run";
+		skewed_reads_driver(client_id, rounds, label);
+	} else if (test == "table_codec_bench") {
+		int entries = (argc >= 4) ? atoi(argv[3]) : 10000;
+		int rounds = (argc >= 5) ? atoi(argv[4]) : 50;
+		table_codec_bench_driver(std::max(1, entries), std::max(1, rounds));
+	} else if (test == "compress_bench") {
+		int rounds = (argc >= 4) ? atoi(argv[3]) : 20000;
+		compress_bench_driver(client_id, std::max(1, rounds));
+	} else if (test == "checksum_bench") {
+		int rounds = (argc >= 4) ? atoi(argv[3]) : 20000;
+		checksum_bench_driver(client_id, std::max(1, rounds));
+	} else if (test == "stream_roundtrip") {
+		int megabytes = (argc >= 4) ? atoi(argv[3]) : 4;
+		bool with_shards = argc >= 5 && string(argv[4]) == "shards";
+		stream_roundtrip_driver(client_id, static_cast<size_t>(std::max(1, megabytes)), with_shards);
+	} else if (test == "value_roundtrip") {
+		value_roundtrip(client_id);
+	} else if (test == "decommission") {
+		if (argc < 4) {
+			print_usage(argv[0]);
+			return 1;
+		}
+		decommission_driver(string(argv[3]));
+	} else if (test == "maintenance_traffic") {
+		int seconds = (argc >= 4) ? atoi(argv[3]) : 20;
+		string label = (argc >= 5) ? string(argv[4]) : "run";
+		maintenance_traffic_driver(client_id, seconds, label);
 	} else {
 		print_usage(argv[0]);
 		return 1;
@@ -0,0 +1,115 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+
+// This starts the wheel at tick 0 = start.
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, std::chrono::steady_clock::time_point start)
+    : tick(std::max(std::chrono::milliseconds(1), tick)), origin(start) {
+}
+
+// This converts a time point to a wheel tick, rounding up so timers never fire early.
+uint64_t TimerWheel::tick_of(std::chrono::steady_clock::time_point when) const {
+    if (when <= origin) {
+        return 0;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(when - origin).count();
+    return static_cast<uint64_t>((elapsed + tick.count() - 1) / tick.count());
+}
+
+// This picks the slot for an expiry: the finest level whose span still reaches it.
+size_t TimerWheel::slot_for(uint64_t expiry_tick) const {
+    uint64_t expiry = std::max(expiry_tick, current_tick);
+    uint64_t delta = expiry - current_tick;
+    for (size_t level = 0; level < LEVELS; ++level) {
+        if (delta < (uint64_t(1) << (SLOT_BITS * (level + 1))) || level + 1 == LEVELS) {
+            uint64_t slot = (expiry >> (SLOT_BITS * level)) & (SLOTS - 1);
+            if (level + 1 == LEVELS && delta >= (uint64_t(1) << (SLOT_BITS * LEVELS))) {
+                // beyond the outermost span: park one lap ahead and cascade again later
+                slot = ((current_tick >> (SLOT_BITS * level)) + SLOTS - 1) & (SLOTS - 1);
+            }
+            return level * SLOTS + static_cast<size_t>(slot);
+        }
+    }
+    return 0;
+}
+
+// This moves a timer from one slot list into the slot its expiry calls for.
+void TimerWheel::place(Slot &from, Slot::iterator timer) {
+    size_t index = slot_for(timer->expiry_tick);
+    slots[index].splice(slots[index].end(), from, timer);
+    locations[timer->key] = Location{index, timer};
+}
+
+// This sets (or moves) the deadline for a key.
+void TimerWheel::schedule(const std::string &key, std::chrono::steady_clock::time_point deadline) {
+    // a deadline at or before the current tick fires on the next advance
+    uint64_t expiry = std::max(tick_of(deadline), current_tick + 1);
+    auto found = locations.find(key);
+    if (found != locations.end()) {
+        Slot &current = slots[found->second.slot_index];
+        found->second.position->expiry_tick = expiry;
+        place(current, found->second.position);
+        return;
+    }
+    Slot pending;
+    pending.push_back(Timer{key, expiry});
+    place(pending, pending.begin());
+}
+
+// This removes a key's deadline, if it has one.
+void TimerWheel::cancel(const std::string &key) {
+    auto found = locations.find(key);
+    if (found == locations.end()) {
+        return;
+    }
+    slots[found->second.slot_index].erase(found->second.position);
+    locations.erase(found);
+}
+
+// This re-files every timer of the level's current slot into finer levels.
+void TimerWheel::cascade(size_t level) {
+    size_t index = level * SLOTS + static_cast<size_t>((current_tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+    Slot due;
+    due.splice(due.end(), slots[index]);
+    while (!due.empty()) {
+        place(due, due.begin());
+    }
+}
+
+// This turns the wheel up to now and returns the keys whose deadline passed.
+std::vector<std::string> TimerWheel::advance(std::chrono::steady_clock::time_point now) {
+    std::vector<std::string> expired;
+    uint64_t target = tick_of(now);
+    // an idle wheel can jump straight to now
+    if (locations.empty()) {
+        current_tick = std::max(current_tick, target);
+        return expired;
+    }
+    while (current_tick < target) {
+        ++current_tick;
+        // when a level wraps, the next level's slot for this lap comes due
+        for (size_t level = 1; level < LEVELS; ++level) {
+            if ((current_tick & ((uint64_t(1) << (SLOT_BITS * level)) - 1)) != 0) {
+                break;
+            }
+            cascade(level);
+        }
+        Slot &slot = slots[static_cast<size_t>(current_tick & (SLOTS - 1))];
+        auto it = slot.begin();
+        while (it != slot.end()) {
+            if (it->expiry_tick <= current_tick) {
+                expired.push_back(it->key);
+                locations.erase(it->key);
+                it = slot.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    return expired;
+}
+
+// This returns the number of pending timers.
+size_t TimerWheel::size() const {
+    return locations.size();
+}
@@ -0,0 +1,61 @@
+#ifndef GTSTORE_TIMER_WHEEL_HPP
+#define GTSTORE_TIMER_WHEEL_HPP
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// NEWLY ADDED: hierarchical timer wheel keyed by name.
+// Four levels of 64 slots; a timer sits in the coarsest level whose span
+// covers its remaining time and cascades down as the wheel turns. Scheduling,
+// rescheduling and cancelling are O(1), and advancing only touches the slots
+// the clock passes plus the timers that actually fire.
+class TimerWheel {
+public:
+    TimerWheel(std::chrono::milliseconds tick, std::chrono::steady_clock::time_point start);
+
+    // This sets (or moves) the deadline for a key.
+    void schedule(const std::string &key, std::chrono::steady_clock::time_point deadline);
+
+    // This removes a key's deadline, if it has one.
+    void cancel(const std::string &key);
+
+    // This turns the wheel up to now and returns the keys whose deadline passed.
+    std::vector<std::string> advance(std::chrono::steady_clock::time_point now);
+
+    // This returns the number of pending timers.
+    size_t size() const;
+
+private:
+    static const size_t LEVELS = 4;
+    static const unsigned SLOT_BITS = 6;
+    static const size_t SLOTS = 1u << SLOT_BITS;
+
+    struct Timer {
+        std::string key;
+        uint64_t expiry_tick;
+    };
+    typedef std::list<Timer> Slot;
+
+    struct Location {
+        size_t slot_index;
+        Slot::iterator position;
+    };
+
+    std::chrono::milliseconds tick;
+    std::chrono::steady_clock::time_point origin;
+    uint64_t current_tick = 0;
+    std::array<Slot, LEVELS * SLOTS> slots;
+    std::unordered_map<std::string, Location> locations;
+
+    uint64_t tick_of(std::chrono::steady_clock::time_point when) const;
+    size_t slot_for(uint64_t expiry_tick) const;
+    void place(Slot &from, Slot::iterator timer);
+    void cascade(size_t level);
+};
+
+#endif
@@ -1,12 +1,17 @@
 #include "utils.hpp"
+#include "codec.hpp"
+#include "messages.hpp"
 
+#include <algorithm>
 #include <cctype>
+#include <charconv>
 #include <cstdlib>
 #include <ctime>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <unordered_map>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -47,27 +52,47 @@ void log_line(const std::string &level, const std::string &message) {
     }
 }
 
-// This splits a string by the delimiter.
-std::vector<std::string> split(const std::string &input, char delimiter) {
-    std::vector<std::string> parts;
-    std::string current;
-    std::istringstream stream(input);
-    while (std::getline(stream, current, delimiter)) {
-        parts.push_back(current);
+// This splits input at the delimiter into views of input, reusing the caller's vector.
+void split_view(std::string_view input, char delimiter, std::vector<std::string_view> &fields) {
+    fields.clear();
+    size_t start = 0;
+    while (start < input.size()) {
+        size_t end = input.find(delimiter, start);
+        if (end == std::string_view::npos) {
+            end = input.size();
+        }
+        fields.push_back(input.substr(start, end - start));
+        start = end + 1;
     }
-    return parts;
 }
 
-// This joins strings with the delimiter.
-std::string join(const std::vector<std::string> &parts, char delimiter) {
-    std::ostringstream builder;
+// This parses a whole field as an unsigned decimal with from_chars, which neither allocates nor throws.
+bool parse_u64(std::string_view field, uint64_t &value) {
+    const char *end = field.data() + field.size();
+    auto result = std::from_chars(field.data(), end, value);
+    return !field.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+// This appends parts to out with the delimiter between them, growing out once.
+void append_joined(std::string &out, const std::vector<std::string> &parts, char delimiter) {
+    size_t total = out.size() + parts.size();
+    for (const auto &part : parts) {
+        total += part.size();
+    }
+    out.reserve(total);
     for (size_t i = 0; i < parts.size(); ++i) {
-        builder << parts[i];
-        if (i + 1 < parts.size()) {
-            builder << delimiter;
+        if (i > 0) {
+            out.push_back(delimiter);
         }
+        out += parts[i];
     }
-    return builder.str();
+}
+
+// This joins strings with the delimiter.
+std::string join(const std::vector<std::string> &parts, char delimiter) {
+    std::string out;
+    append_joined(out, parts, delimiter);
+    return out;
 }
 
 // This trims whitespace from both ends.
@@ -83,52 +108,450 @@ std::string trim(const std::string &value) {
     return value.substr(start, end - start);
 }
 
-// This converts the storage table to a payload string.
-std::string build_table_payload(const std::vector<StorageNodeInfo> &nodes, size_t replication_factor) {
-    std::vector<std::string> rows;
+namespace {
+// Binary table layout, all integers varints unless noted:
+//   version byte, replication, epoch, [base epoch for deltas], placement byte,
+//   host count + hosts, node count + nodes (id, host index, port, weight, jump bucket),
+//   entry lists (count + per entry node index and little-endian 8-byte token),
+//   hot key count + 8-byte hashes, share count + (node id, keep percent), draining count + node ids.
+// Hosts and nodes are written once however many tokens a node has.
+const uint8_t TABLE_FORMAT_VERSION = 3;
+
+// This appends a little-endian fixed 64-bit word.
+void put_fixed64(std::string &out, uint64_t value) {
+    char bytes[8];
+    for (int i = 0; i < 8; ++i) {
+        bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    out.append(bytes, 8);
+}
+
+// This appends a varint-length string.
+void put_bytes(std::string &out, const std::string &value) {
+    put_varint(out, value.size());
+    out.append(value);
+}
+
+// NEWLY ADDED: writes entry lists against shared host and node dictionaries.
+class TableWriter {
+public:
+    // This interns the hosts and nodes of every list that will be written.
+    void intern(const std::vector<StorageNodeInfo> &entries) {
+        for (const auto &entry : entries) {
+            if (node_index.count(entry.node_id)) {
+                continue;
+            }
+            auto host = host_index.find(entry.address.host);
+            if (host == host_index.end()) {
+                host = host_index.emplace(entry.address.host, static_cast<uint32_t>(hosts.size())).first;
+                hosts.push_back(&entry.address.host);
+            }
+            node_index.emplace(entry.node_id, static_cast<uint32_t>(nodes.size()));
+            nodes.push_back(std::make_pair(&entry, host->second));
+        }
+    }
+
+    // This writes both dictionaries.
+    void write_dictionaries(std::string &out) const {
+        put_varint(out, hosts.size());
+        for (const std::string *host : hosts) {
+            put_bytes(out, *host);
+        }
+        put_varint(out, nodes.size());
+        for (const auto &node : nodes) {
+            put_bytes(out, node.first->node_id);
+            put_varint(out, node.second);
+            put_varint(out, node.first->address.port);
+            put_varint(out, node.first->weight);
+            put_varint(out, node.first->bucket);
+        }
+    }
+
+    // This writes one entry list as node indexes and fixed-width tokens.
+    void write_entries(std::string &out, const std::vector<StorageNodeInfo> &entries) const {
+        put_varint(out, entries.size());
+        for (const auto &entry : entries) {
+            put_varint(out, node_index.at(entry.node_id));
+            put_fixed64(out, entry.token);
+        }
+    }
+
+private:
+    std::vector<const std::string *> hosts;
+    std::unordered_map<std::string, uint32_t> host_index;
+    std::vector<std::pair<const StorageNodeInfo *, uint32_t>> nodes;
+    std::unordered_map<std::string, uint32_t> node_index;
+};
+
+// This appends the hot key, load share and draining sections.
+void write_extras(std::string &out, const std::vector<uint64_t> &hot_keys, const std::vector<NodeLoadShare> &shares,
+                  const std::vector<std::string> &draining) {
+    put_varint(out, hot_keys.size());
+    for (uint64_t key_hash : hot_keys) {
+        put_fixed64(out, key_hash);
+    }
+    put_varint(out, shares.size());
+    for (const auto &share : shares) {
+        put_bytes(out, share.node_id);
+        put_varint(out, share.keep_percent);
+    }
+    put_varint(out, draining.size());
+    for (const auto &node_id : draining) {
+        put_bytes(out, node_id);
+    }
+}
+
+// NEWLY ADDED: bounds-checked cursor over a binary table payload.
+// Any read past the end or out-of-range index marks the whole payload bad.
+class TableReader {
+public:
+    explicit TableReader(const std::string &payload) : data(payload) {}
+
+    bool ok() const { return good; }
+
+    bool at_end() const { return pos == data.size(); }
+
+    // This reads a varint.
+    uint64_t varint() {
+        uint64_t value = 0;
+        if (good && !get_varint(data, pos, value)) {
+            good = false;
+        }
+        return good ? value : 0;
+    }
+
+    // This reads a count, rejecting ones the remaining bytes could not hold.
+    size_t count(size_t min_item_bytes) {
+        uint64_t value = varint();
+        if (good && value > (data.size() - pos) / std::max<size_t>(1, min_item_bytes)) {
+            good = false;
+        }
+        return good ? static_cast<size_t>(value) : 0;
+    }
+
+    // This reads one byte.
+    uint8_t byte() {
+        if (!good || pos >= data.size()) {
+            good = false;
+            return 0;
+        }
+        return static_cast<uint8_t>(data[pos++]);
+    }
+
+    // This reads a little-endian fixed 64-bit word.
+    uint64_t fixed64() {
+        if (!good || data.size() - pos < 8) {
+            good = false;
+            return 0;
+        }
+        uint64_t value = 0;
+        for (int i = 0; i < 8; ++i) {
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(data[pos + i])) << (8 * i);
+        }
+        pos += 8;
+        return value;
+    }
+
+    // This reads a varint-length string into out.
+    void bytes(std::string &out) {
+        size_t length = count(1);
+        if (good) {
+            out.assign(data, pos, length);
+            pos += length;
+        }
+    }
+
+    // This reads the host and node dictionaries into entry templates (token left unset).
+    void dictionaries(std::vector<StorageNodeInfo> &nodes) {
+        std::vector<std::string> hosts(count(1));
+        for (auto &host : hosts) {
+            bytes(host);
+        }
+        nodes.resize(count(5));
+        for (auto &node : nodes) {
+            bytes(node.node_id);
+            uint64_t host = varint();
+            if (host >= hosts.size()) {
+                good = false;
+                return;
+            }
+            node.address.host = hosts[host];
+            node.address.port = static_cast<uint16_t>(varint());
+            node.weight = static_cast<uint32_t>(varint());
+            uint64_t bucket = varint();
+            if (bucket >= MAX_JUMP_BUCKETS) {
+                good = false;
+                return;
+            }
+            node.bucket = static_cast<uint32_t>(bucket);
+            node.token = 0;
+        }
+    }
+
+    // This reads one entry list by copying dictionary templates and filling in tokens.
+    void entries(const std::vector<StorageNodeInfo> &nodes, std::vector<StorageNodeInfo> &out) {
+        size_t total = count(9);
+        out.clear();
+        out.reserve(total);
+        for (size_t i = 0; i < total && good; ++i) {
+            uint64_t node = varint();
+            if (node >= nodes.size()) {
+                good = false;
+                return;
+            }
+            out.push_back(nodes[node]);
+            out.back().token = fixed64();
+        }
+    }
+
+    // This reads the hot key, load share and draining sections.
+    void extras(std::vector<uint64_t> &hot_keys, std::vector<NodeLoadShare> &shares, std::vector<std::string> &draining) {
+        hot_keys.resize(count(8));
+        for (auto &key_hash : hot_keys) {
+            key_hash = fixed64();
+        }
+        shares.resize(count(2));
+        for (auto &share : shares) {
+            bytes(share.node_id);
+            share.keep_percent = static_cast<uint32_t>(varint());
+        }
+        draining.resize(count(1));
+        for (auto &node_id : draining) {
+            bytes(node_id);
+        }
+    }
+
+private:
+    const std::string &data;
+    size_t pos = 0;
+    bool good = true;
+};
+
+// This tells whether a placement byte names a mode this build knows.
+bool placement_known(uint8_t placement) {
+    return placement <= static_cast<uint8_t>(PlacementMode::BOUNDED);
+}
+
+// This tells whether two rows describe the same ring entry.
+bool same_entry(const StorageNodeInfo &lhs, const StorageNodeInfo &rhs) {
+    return lhs.node_id == rhs.node_id && lhs.token == rhs.token;
+}
+}
+
+// This formats table entries for logging, one item per node.
+std::string describe_nodes(const std::vector<StorageNodeInfo> &nodes) {
+    if (nodes.empty()) {
+        return "<empty>";
+    }
+    std::vector<std::string> order;
+    std::unordered_map<std::string, size_t> token_counts;
+    std::unordered_map<std::string, const StorageNodeInfo *> first_entry;
     for (const auto &node : nodes) {
-        std::ostringstream row;
-        row << node.node_id << "," << node.address.host << "," << node.address.port << "," << node.token;
-        rows.push_back(row.str());
+        if (token_counts[node.node_id]++ == 0) {
+            order.push_back(node.node_id);
+            first_entry[node.node_id] = &node;
+        }
+    }
+    std::ostringstream out;
+    for (size_t i = 0; i < order.size(); ++i) {
+        const StorageNodeInfo &node = *first_entry[order[i]];
+        out << node.node_id << "@" << node.address.host << ":" << node.address.port
+            << " weight=" << node.weight << " tokens=" << token_counts[order[i]];
+        if (i + 1 < order.size()) {
+            out << " | ";
+        }
+    }
+    return out.str();
+}
+
+// This converts the storage table to a binary payload.
+std::string build_table_payload(const TableSnapshot &table) {
+    TableWriter writer;
+    writer.intern(table.nodes);
+    std::string out;
+    out.reserve(64 + table.nodes.size() * 10);
+    out.push_back(static_cast<char>(TABLE_FORMAT_VERSION));
+    put_varint(out, table.replication_factor);
+    put_varint(out, table.epoch);
+    out.push_back(static_cast<char>(table.placement));
+    writer.write_dictionaries(out);
+    writer.write_entries(out, table.nodes);
+    write_extras(out, table.hot_keys, table.load_shares, table.draining);
+    return out;
+}
+
+// This parses a binary payload back into storage entries. A malformed payload, an unknown
+// placement byte or an unknown version gives an empty table at epoch 0.
+TableSnapshot parse_table_payload(const std::string &payload) {
+    TableSnapshot table;
+    TableReader reader(payload);
+    if (reader.byte() != TABLE_FORMAT_VERSION) {
+        log_line("WARN", "unsupported routing table format");
+        return TableSnapshot{{}, 1, 0, PlacementMode::RING, {}, {}};
+    }
+    table.replication_factor = std::max<size_t>(1, static_cast<size_t>(reader.varint()));
+    table.epoch = reader.varint();
+    uint8_t placement = reader.byte();
+    table.placement = static_cast<PlacementMode>(placement);
+    std::vector<StorageNodeInfo> nodes;
+    reader.dictionaries(nodes);
+    reader.entries(nodes, table.nodes);
+    reader.extras(table.hot_keys, table.load_shares, table.draining);
+    if (!reader.ok() || !reader.at_end() || !placement_known(placement)) {
+        log_line("WARN", "malformed routing table payload");
+        return TableSnapshot{{}, 1, 0, PlacementMode::RING, {}, {}};
+    }
+    return table;
+}
+
+// This converts a table delta to a binary payload.
+std::string build_delta_payload(const TableDelta &delta) {
+    TableWriter writer;
+    writer.intern(delta.added);
+    writer.intern(delta.removed);
+    std::string out;
+    out.push_back(static_cast<char>(TABLE_FORMAT_VERSION));
+    put_varint(out, delta.replication_factor);
+    put_varint(out, delta.epoch);
+    put_varint(out, delta.base_epoch);
+    out.push_back(static_cast<char>(delta.placement));
+    writer.write_dictionaries(out);
+    writer.write_entries(out, delta.added);
+    writer.write_entries(out, delta.removed);
+    write_extras(out, delta.hot_keys, delta.load_shares, delta.draining);
+    return out;
+}
+
+// This parses a binary delta payload.
+bool parse_delta_payload(const std::string &payload, TableDelta &delta) {
+    TableReader reader(payload);
+    if (reader.byte() != TABLE_FORMAT_VERSION) {
+        return false;
     }
-    std::string table = join(rows, ';');
-    return std::to_string(replication_factor) + "#" + table;
+    delta.replication_factor = std::max<size_t>(1, static_cast<size_t>(reader.varint()));
+    delta.epoch = reader.varint();
+    delta.base_epoch = reader.varint();
+    uint8_t placement = reader.byte();
+    delta.placement = static_cast<PlacementMode>(placement);
+    std::vector<StorageNodeInfo> nodes;
+    reader.dictionaries(nodes);
+    reader.entries(nodes, delta.added);
+    reader.entries(nodes, delta.removed);
+    reader.extras(delta.hot_keys, delta.load_shares, delta.draining);
+    return reader.ok() && reader.at_end() && placement_known(placement);
 }
 
-// This parses a payload back into storage entries.
-std::vector<StorageNodeInfo> parse_table_payload(const std::string &payload, size_t &replication_factor) {
+// This applies a delta to a table in place.
+void apply_table_delta(TableSnapshot &table, const TableDelta &delta) {
     std::vector<StorageNodeInfo> result;
-    replication_factor = 1;
-    std::string table_section = payload;
-    auto hash_pos = payload.find('#');
-    if (hash_pos != std::string::npos) {
-        std::string prefix = trim(payload.substr(0, hash_pos));
-        if (!prefix.empty()) {
-            try {
-                replication_factor = static_cast<size_t>(std::stoul(prefix));
-            } catch (...) {
-                replication_factor = 1;
+    result.reserve(table.nodes.size() + delta.added.size());
+    for (const auto &node : table.nodes) {
+        bool dropped = false;
+        for (const auto &gone : delta.removed) {
+            if (same_entry(node, gone)) {
+                dropped = true;
+                break;
             }
         }
-        table_section = payload.substr(hash_pos + 1);
+        if (!dropped) {
+            result.push_back(node);
+        }
+    }
+    for (const auto &node : delta.added) {
+        result.push_back(node);
+    }
+    table.nodes.swap(result);
+    table.replication_factor = delta.replication_factor;
+    table.epoch = delta.epoch;
+    table.placement = delta.placement;
+    table.hot_keys = delta.hot_keys;
+    table.load_shares = delta.load_shares;
+    table.draining = delta.draining;
+}
+
+// This brings a table copy up to date from a table server.
+SyncResult sync_table(const NodeAddress &source, TableSnapshot &table) {
+    int fd = connect_to_host(source);
+    if (fd < 0) {
+        log_line("ERROR", "failed to reach table server for refresh");
+        return SyncResult::FAILED;
     }
-    auto rows = split(table_section, ';');
-    for (const auto &row : rows) {
-        if (row.empty()) {
-            continue;
+    bool incremental = table.epoch != 0 && !table.nodes.empty();
+    bool sent = incremental ? send_typed<MessageType::TABLE_SYNC>(fd, {table.epoch})
+                            : send_message(fd, MessageType::CLIENT_HELLO, "");
+    if (!sent) {
+        log_line("ERROR", "could not send hello");
+        close(fd);
+        return SyncResult::FAILED;
+    }
+    MessageType type;
+    std::string payload;
+    if (!recv_message(fd, type, payload)) {
+        log_line("ERROR", "no table from table server");
+        close(fd);
+        return SyncResult::FAILED;
+    }
+    close(fd);
+    if (type == MessageType::TABLE_UNCHANGED) {
+        return SyncResult::UNCHANGED;
+    }
+    if (type == MessageType::TABLE_DELTA) {
+        TableDelta delta;
+        if (!parse_delta_payload(payload, delta) || delta.base_epoch != table.epoch) {
+            log_line("WARN", "unusable table delta, fetching full table");
+            TableSnapshot fresh;
+            fresh.epoch = 0;
+            SyncResult result = sync_table(source, fresh);
+            if (result == SyncResult::UPDATED) {
+                table = fresh;
+            }
+            return result;
         }
-        auto cols = split(row, ',');
-        if (cols.size() != 4) {
-            continue;
+        apply_table_delta(table, delta);
+        log_line("INFO", "Applied table delta " + std::to_string(delta.base_epoch) + "->" + std::to_string(delta.epoch) +
+                 " (+" + std::to_string(delta.added.size()) + " -" + std::to_string(delta.removed.size()) + ")");
+        return SyncResult::UPDATED;
+    }
+    if (type == MessageType::TABLE_PUSH) {
+        // a payload that does not parse comes back empty at epoch 0; keep the table we have
+        TableSnapshot fresh = parse_table_payload(payload);
+        if (fresh.epoch == 0 || fresh.nodes.empty()) {
+            log_line("WARN", "table server sent an unusable table");
+            return SyncResult::FAILED;
         }
-        StorageNodeInfo info;
-        info.node_id = trim(cols[0]);
-        info.address.host = trim(cols[1]);
-        info.address.port = static_cast<uint16_t>(std::stoi(cols[2]));
-        info.token = static_cast<uint64_t>(std::stoull(cols[3]));
-        result.push_back(info);
+        table = std::move(fresh);
+        return SyncResult::UPDATED;
+    }
+    log_line("WARN", "table server replied without table");
+    return SyncResult::FAILED;
+}
+
+// This names a placement mode for logs and config.
+std::string placement_name(PlacementMode mode) {
+    switch (mode) {
+    case PlacementMode::RENDEZVOUS:
+        return "rendezvous";
+    case PlacementMode::JUMP:
+        return "jump";
+    case PlacementMode::BOUNDED:
+        return "bounded";
+    default:
+        return "ring";
+    }
+}
+
+// This parses a placement name, falling back to the ring.
+PlacementMode parse_placement(const std::string &name) {
+    if (name == "rendezvous" || name == "hrw") {
+        return PlacementMode::RENDEZVOUS;
+    }
+    if (name == "jump") {
+        return PlacementMode::JUMP;
+    }
+    if (name == "bounded") {
+        return PlacementMode::BOUNDED;
     }
-    return result;
+    return PlacementMode::RING;
 }
 
 // This reads a port value from argv.
@@ -2,6 +2,7 @@
 #define GTSTORE_UTILS_HPP
 
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "net_common.hpp"
@@ -14,8 +15,15 @@ void setup_logging(const std::string &component_name);
 // This prints and writes a log line.
 void log_line(const std::string &level, const std::string &message);
 
-// This splits a string by the delimiter.
-std::vector<std::string> split(const std::string &input, char delimiter);
+// This splits input at the delimiter into views of input, reusing the caller's vector. An empty input gives
+// no fields and a trailing delimiter adds no empty field. The views are valid while input is.
+void split_view(std::string_view input, char delimiter, std::vector<std::string_view> &fields);
+
+// This parses a whole field as an unsigned decimal; false on empty input, stray characters or overflow.
+bool parse_u64(std::string_view field, uint64_t &value);
+
+// This appends parts to out with the delimiter between them.
+void append_joined(std::string &out, const std::vector<std::string> &parts, char delimiter);
 
 // This joins strings with the delimiter.
 std::string join(const std::vector<std::string> &parts, char delimiter);
@@ -23,11 +31,39 @@ std::string join(const std::vector<std::string> &parts, char delimiter);
 // This trims whitespace from both ends.
 std::string trim(const std::string &value);
 
-// This converts the storage table plus replication factor to a payload string.
-std::string build_table_payload(const std::vector<StorageNodeInfo> &nodes, size_t replication_factor);
+// This formats table entries for logging, one item per node with its token count.
+std::string describe_nodes(const std::vector<StorageNodeInfo> &nodes);
+
+// This converts the storage table plus replication factor, epoch and placement to a payload string.
+std::string build_table_payload(const TableSnapshot &table);
+
+// This parses a payload back into storage entries and extracts replication factor, epoch and placement.
+TableSnapshot parse_table_payload(const std::string &payload);
+
+// This converts a table delta to a payload string.
+std::string build_delta_payload(const TableDelta &delta);
+
+// This parses a delta payload, returning false when it is malformed.
+bool parse_delta_payload(const std::string &payload, TableDelta &delta);
+
+// This applies a delta to a table in place.
+void apply_table_delta(TableSnapshot &table, const TableDelta &delta);
+
+// NEWLY ADDED: outcome of a table sync round trip
+enum class SyncResult {
+    FAILED,
+    UNCHANGED,
+    UPDATED
+};
+
+// This brings a table copy up to date from a table server, using deltas when possible.
+SyncResult sync_table(const NodeAddress &source, TableSnapshot &table);
+
+// This names a placement mode for logs and config.
+std::string placement_name(PlacementMode mode);
 
-// This parses a payload back into storage entries and extracts replication factor.
-std::vector<StorageNodeInfo> parse_table_payload(const std::string &payload, size_t &replication_factor);
+// This parses a placement name, falling back to the ring.
+PlacementMode parse_placement(const std::string &name);
 
 // This reads a port value from argv.
 uint16_t read_port_from_arg(int argc, char **argv, uint16_t default_port);